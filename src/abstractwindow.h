@@ -45,7 +45,17 @@ namespace dfm {
  */
 class AbstractWindow {
 public:
-    enum MessageType { MESSAGE_INFO, MESSAGE_WARNING, MESSAGE_ERROR };
+    /*
+     * The output types are for output from commands, passed on as it arrives
+     * in pieces that aren't necessarily whole lines.
+     */
+    enum MessageType {
+        MESSAGE_INFO,
+        MESSAGE_WARNING,
+        MESSAGE_ERROR,
+        MESSAGE_OUTPUT,
+        MESSAGE_ERROR_OUTPUT
+    };
     virtual void message(const std::string& message, MessageType type) = 0;
     virtual void editMessage(MessageAction& action) = 0;
     virtual void editDependency(DependencyAction& action) = 0;
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "arena.h"
+
+#include <stdint.h>
+
+namespace dfm {
+
+Arena::Arena()
+{
+}
+
+void*
+Arena::allocate(size_t size, size_t alignment)
+{
+    size_t padding = -reinterpret_cast<uintptr_t>(current) & (alignment - 1);
+    if (current == nullptr || padding + size > remaining) {
+        /* Blocks from new[] are aligned for anything. */
+        size_t blockSize = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+        blocks.push_back(std::unique_ptr<char[]>(new char[blockSize]));
+        current = blocks.back().get();
+        remaining = blockSize;
+        padding = 0;
+    }
+    void* memory = current + padding;
+    current += padding + size;
+    remaining -= padding + size;
+    return memory;
+}
+} /* namespace dfm */
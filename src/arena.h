@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "config.h"
+
+#include <stddef.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace dfm {
+
+/* The size of each block that an arena hands out memory from. */
+const size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+/*
+ * Memory for objects that are made together and live about as long as each
+ * other, like the actions read from a config file. Memory is handed out from
+ * large blocks and is only freed, all at once, when the arena is destroyed.
+ * Allocating isn't thread safe, but the blocks are never touched again after
+ * that, so objects in them can be used and destroyed on any thread.
+ */
+class Arena {
+public:
+    Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /*
+     * Returns size bytes aligned to alignment, which must be a power of two
+     * no more than that of max_align_t.
+     */
+    void* allocate(size_t size, size_t alignment);
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    /* The unused part of the last block. */
+    char* current = nullptr;
+    size_t remaining = 0;
+};
+
+/*
+ * An allocator that takes memory from an arena and keeps it alive, so that
+ * objects made with it can outlive whatever made them. Deallocating does
+ * nothing.
+ */
+template <class T> class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    ArenaAllocator(std::shared_ptr<Arena> arena) : arena(std::move(arena))
+    {
+    }
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena)
+    {
+    }
+
+    T*
+    allocate(size_t count)
+    {
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void
+    deallocate(T*, size_t)
+    {
+    }
+
+    std::shared_ptr<Arena> arena;
+};
+
+template <class T, class U>
+bool
+operator==(const ArenaAllocator<T>& first, const ArenaAllocator<U>& second)
+{
+    return first.arena == second.arena;
+}
+
+template <class T, class U>
+bool
+operator!=(const ArenaAllocator<T>& first, const ArenaAllocator<U>& second)
+{
+    return !(first == second);
+}
+
+/*
+ * Makes a T with arguments in arena, along with its reference count, or on
+ * the heap like std::make_shared() if arena is null.
+ *
+ * Returns a pointer that keeps the arena alive for as long as it's used.
+ */
+template <class T, class... Arguments>
+std::shared_ptr<T>
+makeArenaShared(const std::shared_ptr<Arena>& arena, Arguments&&... arguments)
+{
+    if (!arena)
+        return std::make_shared<T>(std::forward<Arguments>(arguments)...);
+    return std::allocate_shared<T>(
+        ArenaAllocator<T>(arena), std::forward<Arguments>(arguments)...);
+}
+} /* namespace dfm */
+
+#endif /* ARENA_H */
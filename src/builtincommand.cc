@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "builtincommand.h"
+
+#include <string.h>
+
+namespace dfm {
+
+struct BuiltinCommandName {
+    const char* name;
+    size_t length;
+    BuiltinCommand command;
+};
+
+/*
+ * Every name of every builtin command, each in the slot its hash gives it.
+ * A new name has to go in its own slot, and if that slot is taken, the
+ * constants in hashBuiltinCommandName() have to change so that every name
+ * gets a slot of its own again.
+ */
+static constexpr BuiltinCommandName BUILTIN_COMMAND_NAMES[] = {
+    { "depend", 6, DEPENDENCIES_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { "dep", 3, DEPENDENCIES_BUILTIN_COMMAND },
+    { "msg", 3, MESSAGE_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { "psh", 3, PARALLEL_SHELL_BUILTIN_COMMAND },
+    { "in", 2, INSTALL_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { "uninstall", 9, REMOVE_BUILTIN_COMMAND },
+    { "delete", 6, REMOVE_BUILTIN_COMMAND },
+    { "message", 7, MESSAGE_BUILTIN_COMMAND },
+    { "remove", 6, REMOVE_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { "timeout", 7, TIMEOUT_BUILTIN_COMMAND },
+    { "m", 1, MESSAGE_BUILTIN_COMMAND },
+    { "parallel-shell", 14, PARALLEL_SHELL_BUILTIN_COMMAND },
+    { "install", 7, INSTALL_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { "shell", 5, SHELL_BUILTIN_COMMAND },
+    { "rm", 2, REMOVE_BUILTIN_COMMAND },
+    { "sh", 2, SHELL_BUILTIN_COMMAND },
+    { "rem", 3, REMOVE_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { nullptr, 0, NO_BUILTIN_COMMAND },
+    { "echo", 4, MESSAGE_BUILTIN_COMMAND },
+    { "dependencies", 12, DEPENDENCIES_BUILTIN_COMMAND },
+    { "i", 1, INSTALL_BUILTIN_COMMAND },
+};
+
+static_assert(sizeof(BUILTIN_COMMAND_NAMES) / sizeof(BUILTIN_COMMAND_NAMES[0])
+        == BUILTIN_COMMAND_SLOTS,
+    "Every slot needs an entry in the builtin command table.");
+
+/* Returns the length of the null terminated string, when compiling. */
+static constexpr size_t
+constantLength(const char* string)
+{
+    return (*string == '\0') ? 0 : 1 + constantLength(string + 1);
+}
+
+/*
+ * Returns whether the entries from slot on are empty or have the right
+ * length and are in the slot their name hashes to.
+ */
+static constexpr bool
+areSlotsCorrect(size_t slot)
+{
+    return slot == BUILTIN_COMMAND_SLOTS
+        || ((BUILTIN_COMMAND_NAMES[slot].name == nullptr
+                || (BUILTIN_COMMAND_NAMES[slot].length
+                           == constantLength(BUILTIN_COMMAND_NAMES[slot].name)
+                       && hashBuiltinCommandName(
+                              BUILTIN_COMMAND_NAMES[slot].length,
+                              BUILTIN_COMMAND_NAMES[slot].name[0],
+                              BUILTIN_COMMAND_NAMES[slot]
+                                  .name[BUILTIN_COMMAND_NAMES[slot].length - 1])
+                           == slot))
+               && areSlotsCorrect(slot + 1));
+}
+
+static_assert(areSlotsCorrect(0),
+    "A builtin command name isn't in the slot that it hashes to.");
+
+BuiltinCommand
+findBuiltinCommand(const StringSlice& name)
+{
+    size_t length = name.getLength();
+    if (length == 0)
+        return NO_BUILTIN_COMMAND;
+    const char* data = name.getData();
+    const BuiltinCommandName& entry = BUILTIN_COMMAND_NAMES[hashBuiltinCommandName(
+        length, data[0], data[length - 1])];
+    if (entry.length != length || memcmp(entry.name, data, length) != 0)
+        return NO_BUILTIN_COMMAND;
+    return entry.command;
+}
+} /* namespace dfm */
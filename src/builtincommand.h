@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef BUILTIN_COMMAND_H
+#define BUILTIN_COMMAND_H
+
+#include "config.h"
+
+#include <stddef.h>
+
+#include "stringslice.h"
+
+namespace dfm {
+
+/*
+ * The commands that every config file can use. Their names are known when
+ * compiling, so they're looked up in a table instead of being registered with
+ * each reader.
+ */
+enum BuiltinCommand {
+    NO_BUILTIN_COMMAND,
+    MESSAGE_BUILTIN_COMMAND,
+    DEPENDENCIES_BUILTIN_COMMAND,
+    REMOVE_BUILTIN_COMMAND,
+    INSTALL_BUILTIN_COMMAND,
+    SHELL_BUILTIN_COMMAND,
+    PARALLEL_SHELL_BUILTIN_COMMAND,
+    /* Sets the timeout of the next shell command instead of being an action. */
+    TIMEOUT_BUILTIN_COMMAND
+};
+
+/* The number of slots in the table of builtin command names. */
+const size_t BUILTIN_COMMAND_SLOTS = 32;
+
+/*
+ * Returns the slot in the table of builtin command names for the name with
+ * the given length, first character, and last character. Every builtin name
+ * has a slot of its own, which is checked when compiling.
+ */
+constexpr size_t
+hashBuiltinCommandName(size_t length, unsigned char first, unsigned char last)
+{
+    return (length * 2 + first * 7 + last * 14) % BUILTIN_COMMAND_SLOTS;
+}
+
+/*
+ * Returns the builtin command called name, or NO_BUILTIN_COMMAND if there
+ * isn't one.
+ */
+BuiltinCommand findBuiltinCommand(const StringSlice& name);
+} /* namespace dfm */
+
+#endif /* BUILTIN_COMMAND_H */
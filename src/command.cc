@@ -25,12 +25,13 @@
 #include "command.h"
 
 #include <assert.h>
-#include <err.h>
 
 #include <algorithm>
 #include <iostream>
 #include <sstream>
 
+#include "util.h"
+
 namespace dfm {
 
 Command::Command()
@@ -135,11 +136,7 @@ std::shared_ptr<ModuleAction>
 Command::createAction(const std::vector<std::string>& arguments,
     ReaderEnvironment& environment) const
 {
-    if (argumentCheckingType == EXACT_COUNT_ARGUMENT_CHECK
-        && !checkArgumentCountEqual(arguments, expectedArgumentCount))
-        return std::shared_ptr<ModuleAction>();
-    if (argumentCheckingType == MINIMUM_COUNT_ARGUMENT_CHECK
-        && !checkArgumentCountAtLeast(arguments, expectedArgumentCount))
+    if (!checkArguments(argumentCheckingType, expectedArgumentCount, arguments))
         return std::shared_ptr<ModuleAction>();
     return createActionFunction(arguments, environment);
 }
@@ -161,7 +158,7 @@ Command::getDefaultAction()
 {
     auto createActionFunction = [](const std::vector<std::string>&,
         const ReaderEnvironment&) -> std::shared_ptr<ModuleAction> {
-        warnx("Calling command without behavior.");
+        configWarning("Calling command without behavior.");
         return std::shared_ptr<ModuleAction>();
     };
     return createActionFunction;
@@ -183,7 +180,7 @@ Command::checkArgumentCountEqual(
     std::ostringstream messageStream;
     messageStream << "Incorrect number of arguments, expected exactly " << argc
                   << ", got " << arguments.size() << ".";
-    warnx("%s", messageStream.str().c_str());
+    configWarning("%s", messageStream.str().c_str());
     return false;
 }
 
@@ -203,7 +200,7 @@ Command::checkArgumentCountAtLeast(
     std::ostringstream messageStream;
     messageStream << "Incorrect number of arguments, expected at least "
                   << argc << ", got " << arguments.size() << ".";
-    warnx("%s", messageStream.str().c_str());
+    configWarning("%s", messageStream.str().c_str());
     return false;
 }
 
@@ -213,4 +210,15 @@ Command::matchesName(const std::string& name) const
     return std::find(callableNames.begin(), callableNames.end(), name)
         != callableNames.end();
 }
+
+bool
+Command::checkArguments(ArgumentCheck argumentCheckingType, int argc,
+    const std::vector<std::string>& arguments)
+{
+    if (argumentCheckingType == EXACT_COUNT_ARGUMENT_CHECK)
+        return checkArgumentCountEqual(arguments, argc);
+    if (argumentCheckingType == MINIMUM_COUNT_ARGUMENT_CHECK)
+        return checkArgumentCountAtLeast(arguments, argc);
+    return true;
+}
 } /* namespace dfm */
@@ -112,6 +112,14 @@ public:
      */
     static bool checkArgumentCountAtLeast(
         const std::vector<std::string>& arguments, int argc);
+    /*
+     * Checks arguments the way argumentCheckingType says to, with argc as the
+     * expected argument count.
+     *
+     * Returns whether or not the arguments passed the check.
+     */
+    static bool checkArguments(ArgumentCheck argumentCheckingType, int argc,
+        const std::vector<std::string>& arguments);
 
 private:
     std::vector<std::string> callableNames;
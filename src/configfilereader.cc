@@ -25,33 +25,36 @@
 #include "configfilereader.h"
 
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdlib.h>
 
-#include <exception>
-#include <regex>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "dependencyaction.h"
 #include "filecheckaction.h"
+#include "modulecache.h"
 #include "removeaction.h"
 #include "util.h"
+#include "variabletemplate.h"
 
 namespace dfm {
 
 ConfigFileReader::ConfigFileReader(const std::string& path)
-    : path(path), reader(path)
+    : path(path), file(path)
 {
     options = std::shared_ptr<DfmOptions>(new DfmOptions());
     environment = ReaderEnvironment(options);
-    addDefaultCommands();
     addDefaultVariables();
 }
 
 ConfigFileReader::ConfigFileReader(
     const std::string& path, std::shared_ptr<DfmOptions> options)
-    : path(path), reader(path), options(options), environment(options)
+    : path(path), file(path), options(options), environment(options)
 {
-    addDefaultCommands();
 }
 
 ConfigFileReader::ConfigFileReader(const char* path)
@@ -59,6 +62,65 @@ ConfigFileReader::ConfigFileReader(const char* path)
 {
 }
 
+ConfigFileReader::ConfigFileReader(const std::string& path,
+    std::shared_ptr<DfmOptions> options, const ReaderEnvironment& environment,
+    const std::vector<Command>& commands)
+    : path(path), options(options), environment(environment),
+      commands(commands)
+{
+    /* Arenas can't be shared between threads. */
+    this->environment.setArena(std::make_shared<Arena>());
+}
+
+std::string
+ConfigFileReader::getCachePath() const
+{
+    std::string::size_type slashPosition = path.rfind('/');
+    if (slashPosition == std::string::npos)
+        return CACHE_FILE_NAME;
+    return path.substr(0, slashPosition + 1) + CACHE_FILE_NAME;
+}
+
+std::string
+ConfigFileReader::createCacheKey() const
+{
+    /*
+     * Install commands use the directory and the default directory, which is
+     * the home directory unless the config file sets it, and the flags are
+     * copied into every action. Paths are left for the actions to expand, so
+     * the environment and the path expansion mode don't matter.
+     */
+    std::string key = environment.getDirectory();
+    key += '\0';
+    key += getHomeDirectory();
+    key += '\0';
+    key += (options->verboseFlag) ? '1' : '0';
+    key += (options->interactiveFlag) ? '1' : '0';
+    return key;
+}
+
+bool
+ConfigFileReader::loadCachedModules(std::vector<Module>& modules)
+{
+    ModuleCache cache(getCachePath());
+    return cache.load(
+        path, file.getContents(), createCacheKey(), modules, environment);
+}
+
+void
+ConfigFileReader::saveCachedModules(const std::vector<Module>& modules)
+{
+    ModuleCache cache(getCachePath());
+    std::string uncachedModule;
+    if (!cache.save(path, file.getContents(), createCacheKey(), modules,
+            environment, &uncachedModule)
+        && !uncachedModule.empty() && options->verboseFlag) {
+        std::cout << "Not caching " << path << " because module "
+                  << uncachedModule << " has an action that can't be cached."
+                  << std::endl;
+    }
+}
+
 std::shared_ptr<DfmOptions>
 ConfigFileReader::getOptions()
 {
@@ -107,42 +169,7 @@ ConfigFileReader::setEnvironment(const ReaderEnvironment& environment)
 bool
 ConfigFileReader::isOpen()
 {
-    return this->reader.is_open();
-}
-
-bool
-ConfigFileReader::isEmptyLine(const std::string& line) const
-{
-    return line.length() == 0;
-}
-
-bool
-ConfigFileReader::isComment(
-    const std::string& line, unsigned int expectedIndents) const
-{
-    std::string::size_type currentIndex = 0;
-    for (; currentIndex < expectedIndents + 1 && currentIndex < line.length();
-         currentIndex++) {
-        if (line[currentIndex] == COMMENT_DELIMITER)
-            return true;
-        else if (line[currentIndex] != '\t')
-            return false;
-    }
-    if (currentIndex < line.length()
-        && line[currentIndex] == COMMENT_DELIMITER)
-        return true;
-
-    return false;
-}
-
-int
-ConfigFileReader::indentCount(const std::string& line) const
-{
-    std::string::size_type indents = 0;
-    /* I could probably use an empty for loop for this. */
-    while (indents < line.length() && line[indents] == '\t')
-        indents++;
-    return indents;
+    return file.isOpen();
 }
 
 int
@@ -158,222 +185,502 @@ ConfigFileReader::getExpectedIndents() const
 }
 
 bool
-ConfigFileReader::isModuleLine(
-    const std::string& line, std::string& moduleName)
+ConfigFileReader::processTimeout(const ConfigLexer& lexer,
+    const std::vector<ConfigLexer::Argument>& arguments)
 {
-    if (isEmptyLine(line) || isComment(line, 0))
+    if (arguments.size() != 1) {
+        errorMessage(lexer.getLine(), "Timeout takes a number of seconds.");
         return false;
-    /*
-     * Match a non-white character at the start, then any more characters and a
-     * colon at the end. Capture the line, except the final colon and any
-     * whitespace between the colon and the name. The name may include
-     * whitespace. There may be trailing whitespace after the colon.
-     */
-    try {
-        std::regex re("^(\\S+(?:\\s+\\S+)*)\\s*:\\s*$");
-        std::smatch match;
-        if (std::regex_match(line, match, re)) {
-            moduleName = match.str(1);
-            return true;
-        }
-    } catch (std::exception& e) {
-        std::cout << e.what() << std::endl;
     }
-    return false;
-}
-
-bool
-ConfigFileReader::isModuleLine(const std::string& line)
-{
-    if (isEmptyLine(line) || isComment(line, 0))
+    std::string text = arguments[0].toString();
+    char* end = nullptr;
+    errno = 0;
+    unsigned long seconds = strtoul(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || !isdigit(text[0]) || errno != 0
+        || seconds == 0 || seconds > UINT_MAX) {
+        errorMessage(lexer.getLine(),
+            "Timeout must be a positive whole number of seconds.");
         return false;
-    std::regex re("^(\\S+(?:\\s+\\S+)*)\\s*:\\s*$");
-    return std::regex_match(line, re);
-}
-
-bool
-ConfigFileReader::isInstallLine(const std::string& line)
-{
-    if (isEmptyLine(line) || isComment(line, 0))
-        return false;
-    std::regex re("^install\\s*:\\s*$");
-    return std::regex_match(line, re);
-}
-
-bool
-ConfigFileReader::isUninstallLine(const std::string& line)
-{
-    if (isEmptyLine(line) || isComment(line, 0))
-        return false;
-    /*
-     * The line must start with uninstall, then there must be a colon, which
-     * may be surrounded by whitespace.
-     */
-    std::regex re("^uninstall\\s*:\\s*$");
-    return std::regex_match(line, re);
-}
-
-bool
-ConfigFileReader::isUpdateLine(const std::string& line)
-{
-    if (isEmptyLine(line) || isComment(line, 0))
-        return false;
-    std::regex re("^update\\s*:\\s*$");
-    return std::regex_match(line, re);
-}
-
-bool
-ConfigFileReader::isShellCommand(const std::string& commandName)
-{
-    return commandName == "sh" || commandName == "shell";
-}
-
-std::string
-ConfigFileReader::stripIndents(const std::string& line, int indents)
-{
-    std::string newLine = line;
-    int indentsToErase = 0;
-    for (; indentsToErase < line.length() && indentsToErase < indents
-         && newLine[indentsToErase] == '\t';
-         indentsToErase++)
-        ;
-    newLine.erase(0, indentsToErase);
-    return newLine;
+    }
+    pendingTimeout = seconds;
+    return true;
 }
 
 void
-ConfigFileReader::addShellAction(const std::string& line)
+ConfigFileReader::addShellAction(const StringSlice& command)
 {
     if (inShell)
-        currentShellAction->addCommand(stripIndents(line, 2));
+        currentShellAction->addCommand(command.toString());
 }
 
 void
 ConfigFileReader::flushShellAction()
 {
     if (inModuleInstall) {
-        currentModule->addInstallAction(
-            std::shared_ptr<ModuleAction>(currentShellAction));
+        currentModule->addInstallAction(currentShellAction);
         inShell = false;
         currentShellAction = nullptr;
     } else if (inModuleUninstall) {
-        currentModule->addUninstallAction(
-            std::shared_ptr<ModuleAction>(currentShellAction));
+        currentModule->addUninstallAction(currentShellAction);
         inShell = false;
         currentShellAction = nullptr;
     } else if (inModuleUpdate) {
-        currentModule->addUpdateAction(
-            std::shared_ptr<ModuleAction>(currentShellAction));
+        currentModule->addUpdateAction(currentShellAction);
         inShell = false;
         currentShellAction = nullptr;
     }
 }
 
 bool
-ConfigFileReader::processLineAsCommand(const std::string& line)
+ConfigFileReader::processLineAsCommand(const ConfigLexer& lexer)
 {
-    std::string localLine = stripIndents(line, 1);
-    /*
-     * Match a string that's not whitespace at the beginning, which is the
-     * command. Capture the command and the rest of the line.
-     */
-    std::regex commandRe("^(\\S+).*$");
-    std::smatch matchResults;
-    if (!std::regex_match(localLine, matchResults, commandRe)) {
-        errorMessage(line, "No command found.");
+    ConfigLexer::CommandLine commandLine;
+    switch (lexer.lexCommand(commandLine)) {
+    case ConfigLexer::NO_COMMAND:
+        errorMessage(lexer.getLine(), "No command found.");
         return false;
-    }
-    std::string command = matchResults.str(1);
-    localLine =
-        localLine.substr(matchResults.position(1) + matchResults.length(1),
-            localLine.length() - matchResults.length(1));
-    std::vector<std::string> arguments;
-    bool success = splitArguments(localLine, arguments);
-    if (!success) {
-        errorMessage(line, "Failed to extract arguments.");
+    case ConfigLexer::BAD_ARGUMENTS:
+        errorMessage(lexer.getLine(), "Failed to extract arguments.");
         return false;
+    case ConfigLexer::COMMAND_OK:
+        break;
     }
-    if (isShellCommand(command)) {
+    BuiltinCommand builtin = findBuiltinCommand(commandLine.name);
+    if (builtin == SHELL_BUILTIN_COMMAND
+        || builtin == PARALLEL_SHELL_BUILTIN_COMMAND) {
         inShell = true;
-        currentShellAction = new ShellAction;
-        /* Match everything after one group of whitespace. */
-        std::regex re("^\\s+(.*)$");
-        std::smatch match;
-        if (std::regex_match(localLine, match, re))
-            currentShellAction->addCommand(match.str(1));
+        currentShellAction =
+            makeArenaShared<ShellAction>(environment.getArena());
+        currentShellAction->setParallelSafe(
+            builtin == PARALLEL_SHELL_BUILTIN_COMMAND);
+        currentShellAction->setTimeout(pendingTimeout);
+        pendingTimeout = 0;
+        if (commandLine.hasShellText)
+            currentShellAction->addCommand(commandLine.shellText.toString());
         return true;
     }
-    return processCommand(command, arguments);
+    if (pendingTimeout > 0) {
+        errorMessage(
+            lexer.getLine(), "Timeout isn't followed by a shell command.");
+        return false;
+    }
+    /* The timeout is for the reader, not an action of its own. */
+    if (builtin == TIMEOUT_BUILTIN_COMMAND)
+        return processTimeout(lexer, commandLine.arguments);
+    std::vector<std::string> arguments;
+    arguments.reserve(commandLine.arguments.size());
+    for (const auto& argument : commandLine.arguments) {
+        arguments.push_back(argument.toString());
+        if (!expandVariables(arguments.back())) {
+            errorMessage(lexer.getLine(), "Failed to expand variables.");
+            return false;
+        }
+    }
+    return processCommand(builtin, commandLine.name.toString(), arguments);
 }
 
 bool
-ConfigFileReader::processLineAsFile(const std::string& line)
+ConfigFileReader::expandVariables(std::string& text) const
 {
-    std::string localLine = stripIndents(line, 1);
-    std::vector<std::string> arguments;
-    if (!splitArguments(line, arguments)) {
-        errorMessage(line, "Failed to extract arguments");
+    if (!VariableTemplate::hasReferences(text))
+        return true;
+    VariableTemplate variableTemplate;
+    if (!variableTemplate.compile(text))
+        return false;
+    std::string expanded;
+    variableTemplate.expand(environment, expanded);
+    text = std::move(expanded);
+    return true;
+}
+
+bool
+ConfigFileReader::assignVariable(
+    const ConfigLexer::Header& header, const StringSlice& line)
+{
+    std::string value = header.variableValue.toString();
+    if (!expandVariables(value)) {
+        errorMessage(line, "Failed to expand variables.");
+        return false;
+    }
+    environment.setVariable(header.variableName.toString(), value);
+    return true;
+}
+
+bool
+ConfigFileReader::processLineAsFile(const ConfigLexer& lexer)
+{
+    std::vector<ConfigLexer::Argument> arguments;
+    if (!lexer.lexArguments(arguments)) {
+        errorMessage(lexer.getLine(), "Failed to extract arguments");
         return false;
     }
-    int argumentCount = arguments.size();
+    std::vector<std::string> values;
+    values.reserve(arguments.size());
+    for (const auto& argument : arguments) {
+        values.push_back(argument.toString());
+        if (!expandVariables(values.back())) {
+            errorMessage(lexer.getLine(), "Failed to expand variables.");
+            return false;
+        }
+    }
+    int argumentCount = values.size();
+    ModuleFile file;
     if (argumentCount == 1)
-        currentModule->addFile(arguments[0]);
+        file = ModuleFile(values[0]);
     else if (argumentCount == 2)
-        currentModule->addFile(arguments[0], arguments[1]);
+        file = ModuleFile(values[0], values[1]);
     else if (argumentCount == 3)
-        currentModule->addFile(arguments[0], arguments[1], arguments[2]);
+        file = ModuleFile(values[0], values[1], values[2]);
     else {
-        errorMessage(line, "Too many arguments to file line.");
+        errorMessage(lexer.getLine(), "Too many arguments to file line.");
+        return false;
+    }
+    file.setInstallMode(fileInstallMode);
+    currentModule->addFile(file);
+    return true;
+}
+
+bool
+ConfigFileReader::processLineAsRequirements(const ConfigLexer& lexer)
+{
+    std::vector<ConfigLexer::Argument> arguments;
+    if (!lexer.lexArguments(arguments)) {
+        errorMessage(lexer.getLine(), "Failed to extract arguments");
         return false;
     }
+    for (const auto& argument : arguments)
+        currentModule->addRequirement(argument.toString());
     return true;
 }
 
+/* How to create the action of a builtin command that makes one. */
+struct BuiltinAction {
+    BuiltinCommand command;
+    Command::ArgumentCheck argumentCheckingType;
+    int expectedArgumentCount;
+    std::shared_ptr<ModuleAction> (*createAction)(
+        const std::vector<std::string>&, ReaderEnvironment&);
+};
+
+/* The action of each builtin command, in the order of BuiltinCommand. */
+static constexpr BuiltinAction BUILTIN_ACTIONS[] = {
+    { NO_BUILTIN_COMMAND, Command::NO_ARGUMENT_CKECK, -1, nullptr },
+    { MESSAGE_BUILTIN_COMMAND, Command::EXACT_COUNT_ARGUMENT_CHECK, 1,
+        &ConfigFileReader::createMessageAction },
+    { DEPENDENCIES_BUILTIN_COMMAND, Command::NO_ARGUMENT_CKECK, -1,
+        &ConfigFileReader::createDependenciesAction },
+    { REMOVE_BUILTIN_COMMAND, Command::MINIMUM_COUNT_ARGUMENT_CHECK, 1,
+        &ConfigFileReader::createRemoveAction },
+    { INSTALL_BUILTIN_COMMAND, Command::MINIMUM_COUNT_ARGUMENT_CHECK, 1,
+        &ConfigFileReader::createInstallAction },
+    /* Shell commands and timeouts are handled by the reader itself. */
+    { SHELL_BUILTIN_COMMAND, Command::NO_ARGUMENT_CKECK, -1, nullptr },
+    { PARALLEL_SHELL_BUILTIN_COMMAND, Command::NO_ARGUMENT_CKECK, -1, nullptr },
+    { TIMEOUT_BUILTIN_COMMAND, Command::NO_ARGUMENT_CKECK, -1, nullptr },
+};
+
+static_assert(BUILTIN_ACTIONS[MESSAGE_BUILTIN_COMMAND].command
+            == MESSAGE_BUILTIN_COMMAND
+        && BUILTIN_ACTIONS[DEPENDENCIES_BUILTIN_COMMAND].command
+            == DEPENDENCIES_BUILTIN_COMMAND
+        && BUILTIN_ACTIONS[REMOVE_BUILTIN_COMMAND].command
+            == REMOVE_BUILTIN_COMMAND
+        && BUILTIN_ACTIONS[INSTALL_BUILTIN_COMMAND].command
+            == INSTALL_BUILTIN_COMMAND
+        && BUILTIN_ACTIONS[TIMEOUT_BUILTIN_COMMAND].command
+            == TIMEOUT_BUILTIN_COMMAND,
+    "Builtin actions must be in the order of BuiltinCommand.");
+
 bool
-ConfigFileReader::processCommand(
+ConfigFileReader::processCommand(BuiltinCommand builtin,
     const std::string& commandName, const std::vector<std::string>& arguments)
 {
-    for (const auto& command : commands) {
-        if (command.matchesName(commandName)) {
-            std::shared_ptr<ModuleAction> action =
-                command.createAction(arguments, environment);
-            setModuleActionFlags(action);
-            if (inModuleInstall) {
-                currentModule->addInstallAction(action);
-                return true;
-            } else if (inModuleUninstall) {
-                currentModule->addUninstallAction(action);
-                return true;
-            } else if (inModuleUpdate) {
-                currentModule->addUpdateAction(action);
-                return true;
-            } else {
-                errorMessageNoLine(
-                    "Trying to add action when not in module install, uninstall, or update: \'%s\"",
-                    commandName.c_str());
-                return false;
-            }
+    std::shared_ptr<ModuleAction> action;
+    if (builtin != NO_BUILTIN_COMMAND
+        && BUILTIN_ACTIONS[builtin].createAction != nullptr) {
+        const BuiltinAction& builtinAction = BUILTIN_ACTIONS[builtin];
+        if (Command::checkArguments(builtinAction.argumentCheckingType,
+                builtinAction.expectedArgumentCount, arguments))
+            action = builtinAction.createAction(arguments, environment);
+    } else {
+        auto command = std::find_if(commands.begin(), commands.end(),
+            [&commandName](const Command& command) {
+                return command.matchesName(commandName);
+            });
+        if (command == commands.end()) {
+            errorMessageNoLine(
+                "No matching command for name \"%s\".", commandName.c_str());
+            return false;
         }
+        action = command->createAction(arguments, environment);
+    }
+
+    setModuleActionFlags(action);
+    if (inModuleInstall) {
+        currentModule->addInstallAction(action);
+        return true;
+    } else if (inModuleUninstall) {
+        currentModule->addUninstallAction(action);
+        return true;
+    } else if (inModuleUpdate) {
+        currentModule->addUpdateAction(action);
+        return true;
     }
     errorMessageNoLine(
-        "No matching command for name \"%s\".", commandName.c_str());
+        "Trying to add action when not in module install, uninstall, or update: \'%s\"",
+        commandName.c_str());
     return false;
 }
 
+bool
+ConfigFileReader::scanModules(std::vector<ModuleLocation>& locations)
+{
+    currentLineNo = 1;
+    moduleLines.clear();
+    inVariables = true;
+    const char* data = file.getData();
+    const char* current = data;
+    const char* end = data + file.getSize();
+    while (current < end) {
+        const char* lineEnd =
+            static_cast<const char*>(memchr(current, '\n', end - current));
+        if (lineEnd == nullptr)
+            lineEnd = end;
+        StringSlice line(current, lineEnd - current);
+        size_t lineStart = current - data;
+        current = lineEnd + 1;
+        ConfigLexer lexer(line);
+        /* Everything that's indented belongs to the module above it. */
+        if (lexer.isEmpty() || lexer.getIndents() > 0) {
+            if (locations.empty() && !lexer.isEmpty() && !lexer.isComment(0)) {
+                errorMessage(line, "Unable to process line.");
+                return false;
+            }
+            currentLineNo++;
+            continue;
+        }
+        ConfigLexer::Header header;
+        lexer.lexHeader(header, inVariables);
+        if (inVariables && header.isAssignment) {
+            if (!assignVariable(header, line))
+                return false;
+            currentLineNo++;
+            continue;
+        }
+        inVariables = false;
+        if (header.type == ConfigLexer::MODULE_HEADER) {
+            ModuleLocation location;
+            location.name = header.moduleName.toString();
+            auto inserted =
+                moduleLines.insert(std::make_pair(location.name, currentLineNo));
+            if (!inserted.second) {
+                errorMessage(line,
+                    "Module \"%s\" is already defined on line %d.",
+                    location.name.c_str(), inserted.first->second);
+                return false;
+            }
+            if (!locations.empty())
+                locations.back().end = lineStart;
+            location.start = lineStart;
+            location.lineNo = currentLineNo;
+            locations.push_back(location);
+        } else if (locations.empty() && !lexer.isComment(0)) {
+            errorMessage(line, "Unable to process line.");
+            return false;
+        }
+        currentLineNo++;
+    }
+    if (!locations.empty())
+        locations.back().end = file.getSize();
+    /*
+     * Each module is parsed on its own, and its header can't be seen twice.
+     * The names aren't needed anymore, so their memory is given back too.
+     */
+    std::unordered_map<std::string, int>().swap(moduleLines);
+    return true;
+}
+
+bool
+ConfigFileReader::splitModules(
+    std::vector<ModuleLocation>& locations, unsigned int& threadCount)
+{
+    if (file.getSize() < PARALLEL_PARSE_MIN_SIZE)
+        return false;
+    threadCount =
+        std::min(std::thread::hardware_concurrency(), MAX_PARSE_THREADS);
+    if (threadCount < 2)
+        return false;
+    /* Errors are found again when parsing on one thread, in file order. */
+    std::vector<ConfigWarning> scanWarnings;
+    collectConfigWarnings(&scanWarnings);
+    bool scanned = scanModules(locations);
+    collectConfigWarnings(nullptr);
+    return scanned && locations.size() > 1;
+}
+
+bool
+ConfigFileReader::parseModulesInParallel(
+    const std::vector<ModuleLocation>& locations, unsigned int threadCount,
+    std::vector<std::vector<Module>>& partModules)
+{
+    /* Each part is a run of whole modules with about the same size. */
+    struct Part {
+        size_t firstLocation;
+        size_t endLocation;
+        std::vector<ConfigWarning> warnings;
+        bool succeeded = false;
+    };
+    size_t partCount = std::min<size_t>(
+        threadCount * PARTS_PER_PARSE_THREAD, locations.size());
+    size_t totalSize = locations.back().end - locations.front().start;
+    std::vector<Part> parts(partCount);
+    partModules.resize(partCount);
+    size_t location = 0;
+    for (size_t i = 0; i < partCount; i++) {
+        parts[i].firstLocation = location;
+        size_t partEnd =
+            locations.front().start + totalSize * (i + 1) / partCount;
+        /* Each part gets a module, and the last one gets the rest. */
+        do {
+            location++;
+        } while (location < locations.size() - (partCount - i - 1)
+            && locations[location].start < partEnd);
+        if (i == partCount - 1)
+            location = locations.size();
+        parts[i].endLocation = location;
+    }
+
+    const char* data = file.getData();
+    std::atomic<size_t> nextPart(0);
+    auto parseParts = [&]() {
+        for (size_t i = nextPart++; i < partCount; i = nextPart++) {
+            Part& part = parts[i];
+            collectConfigWarnings(&part.warnings);
+            ConfigFileReader partReader(path, options, environment, commands);
+            const ModuleLocation& first = locations[part.firstLocation];
+            partReader.inVariables = false;
+            partReader.currentLineNo = first.lineNo;
+            partModules[i].reserve(part.endLocation - part.firstLocation);
+            partReader.moduleLines.reserve(
+                part.endLocation - part.firstLocation);
+            auto output = std::back_inserter(partModules[i]);
+            const char* current = data + first.start;
+            const char* end = data + locations[part.endLocation - 1].end;
+            bool noErrors = true;
+            while (noErrors && current < end)
+                noErrors = partReader.parseLine(current, end, output);
+            partReader.finishModule(output);
+            bool isLastPart = part.endLocation == locations.size();
+            if (noErrors && !isLastPart && partReader.pendingTimeout > 0) {
+                /* On one thread, this is an error on the next header. */
+                const char* fileEnd = data + file.getSize();
+                const char* headerEnd = static_cast<const char*>(
+                    memchr(end, '\n', fileEnd - end));
+                if (headerEnd == nullptr)
+                    headerEnd = fileEnd;
+                partReader.errorMessage(StringSlice(end, headerEnd - end),
+                    "Timeout isn't followed by a shell command.");
+                noErrors = false;
+            }
+            if (noErrors && isLastPart)
+                noErrors = partReader.verifyNothingPending();
+            part.succeeded = noErrors;
+            if (!part.succeeded)
+                partReader.errorMessageNoLine(
+                    "Failed to read config file %s.", path.c_str());
+            collectConfigWarnings(nullptr);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < threadCount; i++)
+        threads.push_back(std::thread(parseParts));
+    parseParts();
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto& part : parts) {
+        giveConfigWarnings(part.warnings);
+        if (!part.succeeded)
+            return false;
+    }
+    return true;
+}
+
+bool
+ConfigFileReader::verifyNothingPending()
+{
+    if (pendingTimeout > 0) {
+        errorMessageNoLine("Timeout isn't followed by a shell command.");
+        return false;
+    }
+    return true;
+}
+
+void
+ConfigFileReader::startParsing()
+{
+    /* A new one so that separate reads don't keep each other's alive. */
+    environment.setArena(std::make_shared<Arena>());
+    currentLineNo = 1;
+    moduleLines.clear();
+    inVariables = true;
+    resetModuleState();
+}
+
+void
+ConfigFileReader::resetModuleState()
+{
+    inFiles = false;
+    inRequirements = false;
+    inModuleInstall = false;
+    inModuleUninstall = false;
+    inModuleUpdate = false;
+    currentModule = nullptr;
+    inShell = false;
+    currentShellAction = nullptr;
+    pendingTimeout = 0;
+}
+
 void
 ConfigFileReader::startNewModule(const std::string& name)
 {
     currentModule = new Module(name);
     inFiles = true;
+    fileInstallMode = COPY_INSTALL_MODE;
+    inRequirements = false;
     inModuleInstall = false;
     inModuleUninstall = false;
     inModuleUpdate = false;
 }
 
+void
+ConfigFileReader::changeToFiles(InstallMode installMode)
+{
+    inModuleInstall = false;
+    inModuleUninstall = false;
+    inModuleUpdate = false;
+    inRequirements = false;
+
+    inFiles = true;
+    fileInstallMode = installMode;
+}
+
+void
+ConfigFileReader::changeToRequirements()
+{
+    inFiles = false;
+    inModuleInstall = false;
+    inModuleUninstall = false;
+    inModuleUpdate = false;
+
+    inRequirements = true;
+}
+
 void
 ConfigFileReader::changeToInstall()
 {
     inFiles = false;
+    inRequirements = false;
     inModuleUninstall = false;
     inModuleUpdate = false;
 
@@ -384,6 +691,7 @@ void
 ConfigFileReader::changeToUninstall()
 {
     inFiles = false;
+    inRequirements = false;
     inModuleInstall = false;
     inModuleUpdate = false;
 
@@ -394,6 +702,7 @@ void
 ConfigFileReader::changeToUpdate()
 {
     inFiles = false;
+    inRequirements = false;
     inModuleInstall = false;
     inModuleUninstall = false;
 
@@ -405,7 +714,7 @@ ConfigFileReader::close()
 {
     if (inModule())
         warnx("Attempting to close reader while still reading.");
-    reader.close();
+    file.close();
 }
 
 void
@@ -464,30 +773,30 @@ std::shared_ptr<ModuleAction>
 ConfigFileReader::createMessageAction(
     const std::vector<std::string>& arguments, ReaderEnvironment& environment)
 {
-    return std::shared_ptr<ModuleAction>(new MessageAction(arguments[0]));
+    return makeArenaShared<MessageAction>(
+        environment.getArena(), arguments[0]);
 }
 
 std::shared_ptr<ModuleAction>
 ConfigFileReader::createDependenciesAction(
     const std::vector<std::string>& arguments, ReaderEnvironment& environment)
 {
-    return std::shared_ptr<DependencyAction>(new DependencyAction(arguments));
+    return makeArenaShared<DependencyAction>(
+        environment.getArena(), arguments);
 }
 
 std::shared_ptr<ModuleAction>
 ConfigFileReader::createRemoveAction(
     const std::vector<std::string>& arguments, ReaderEnvironment& environment)
 {
-    if (arguments.size() == 1) {
-        std::shared_ptr<RemoveAction> action(new RemoveAction(arguments[0]));
-        return action;
-    } else if (arguments.size() == 2) {
-        std::shared_ptr<RemoveAction> action(
-            new RemoveAction(arguments[0], arguments[1]));
-        return action;
-    }
+    if (arguments.size() == 1)
+        return makeArenaShared<RemoveAction>(
+            environment.getArena(), arguments[0]);
+    else if (arguments.size() == 2)
+        return makeArenaShared<RemoveAction>(
+            environment.getArena(), arguments[0], arguments[1]);
 
-    warnx("Too many arguments to create remove action, can only accept two.");
+    configWarning("Too many arguments to create remove action, can only accept two.");
     return std::shared_ptr<ModuleAction>();
 }
 
@@ -495,44 +804,30 @@ std::shared_ptr<ModuleAction>
 ConfigFileReader::createInstallAction(
     const std::vector<std::string>& arguments, ReaderEnvironment& environment)
 {
-    InstallAction* action = nullptr;
-    std::string installationDirectory =
-        shellExpandPath(environment.getVariable("default-directory"));
+    const std::shared_ptr<Arena>& arena = environment.getArena();
+    /*
+     * The paths are expanded when the action is performed, so that they
+     * don't depend on the environment the config file was read in, which
+     * the cache doesn't know about.
+     */
     if (arguments.size() == 1)
-        action = new InstallAction(
-            arguments[0], environment.getDirectory(), installationDirectory);
+        return makeArenaShared<InstallAction>(arena, arguments[0],
+            environment.getDirectory(),
+            environment.getVariable("default-directory"));
     /* Assume that we are working in the current directory. */
     if (arguments.size() == 2)
-        action = new InstallAction(arguments[0], environment.getDirectory(),
-            shellExpandPath(arguments[1]));
+        return makeArenaShared<InstallAction>(
+            arena, arguments[0], environment.getDirectory(), arguments[1]);
     if (arguments.size() == 3)
-        action = new InstallAction(arguments[0], shellExpandPath(arguments[1]),
-            shellExpandPath(arguments[2]));
+        return makeArenaShared<InstallAction>(
+            arena, arguments[0], arguments[1], arguments[2]);
     if (arguments.size() == 4)
-        action = new InstallAction(arguments[0], shellExpandPath(arguments[1]),
-            arguments[2], shellExpandPath(arguments[3]));
-
-    if (action == nullptr) {
-        warnx(
-            "Too many arguments to create an install action, can only accept two to four.");
-        return std::shared_ptr<ModuleAction>();
-    }
-    return std::shared_ptr<ModuleAction>(action);
-}
+        return makeArenaShared<InstallAction>(
+            arena, arguments[0], arguments[1], arguments[2], arguments[3]);
 
-void
-ConfigFileReader::addDefaultCommands()
-{
-    addCommand(&ConfigFileReader::createMessageAction,
-        Command::EXACT_COUNT_ARGUMENT_CHECK, 1, "message", "msg", "echo", "m",
-        NULL);
-    addCommand(&ConfigFileReader::createDependenciesAction,
-        Command::NO_ARGUMENT_CKECK, -1, "dependencies", "dep", "depend", NULL);
-    addCommand(&ConfigFileReader::createRemoveAction,
-        Command::MINIMUM_COUNT_ARGUMENT_CHECK, 1, "remove", "rem", "rm",
-        "delete", "uninstall", NULL);
-    addCommand(&ConfigFileReader::createInstallAction,
-        Command::MINIMUM_COUNT_ARGUMENT_CHECK, 1, "install", "in", "i", NULL);
+    configWarning(
+        "Too many arguments to create an install action, can only accept two to four.");
+    return std::shared_ptr<ModuleAction>();
 }
 
 void
@@ -541,129 +836,10 @@ ConfigFileReader::addDefaultVariables()
     environment.setVariable("default-directory", getHomeDirectory());
 }
 
-bool
-ConfigFileReader::isWhiteSpace(const std::string& string)
-{
-    std::regex whiteRe("\\s+");
-    return std::regex_match(string, whiteRe);
-}
-
-bool
-ConfigFileReader::isWhiteSpace(const char* string)
-{
-    std::regex whiteRe("\\s+");
-    return std::regex_match(string, whiteRe);
-}
-
-bool
-ConfigFileReader::isWhiteSpace(char c)
-{
-    std::regex whiteRe("\\s");
-    char string[] = { c, '\0' };
-    return std::regex_match(string, whiteRe);
-}
-
-bool
-ConfigFileReader::splitArguments(
-    const std::string& argumentsLine, std::vector<std::string>& arguments)
-{
-    arguments.clear();
-    /*
-     * Most of these could be done with a char lastChar variable, but it's
-     * harder for me to think through the logic that way.
-     */
-    bool inQuotes = false;
-    bool inWord = false;
-    bool lastCharEscape = false;
-    bool lastCharClosingQuote = false;
-    bool lastCharQuoteInNonQuoteWord = false;
-
-    std::string currentWord;
-    /*
-     * I could probably do something to make this loop more readable, but I
-     * don't want to. I tried nesting some of the statements but that led
-     * to
-     * too much indentation.
-     */
-    for (std::string::size_type i = 0; i < argumentsLine.length(); i++) {
-        char currentChar = argumentsLine[i];
-        bool isWhite = isWhiteSpace(currentChar);
-        if (inWord && inQuotes && currentChar == '"') {
-            if (!lastCharEscape) {
-                if (currentWord.length() == 0)
-                    warnx("Using empty string as argument: \"%s\".",
-                        argumentsLine.c_str());
-                inQuotes = false;
-                inWord = false;
-                lastCharClosingQuote = true;
-                arguments.push_back(currentWord);
-                currentWord.clear();
-            } else {
-                lastCharEscape = false;
-                currentWord += '"';
-            }
-        } else if (inWord && inQuotes && currentChar == '\\') {
-            if (!lastCharEscape)
-                lastCharEscape = true;
-            else {
-                lastCharEscape = false;
-                currentWord += '\\';
-            }
-        } else if (inWord && inQuotes && lastCharEscape) {
-            lastCharEscape = false;
-            /* It's escaped so don't add it to the word. */
-        } else if (inWord && inQuotes) {
-            currentWord += currentChar;
-        } else if (inWord && currentChar == '"') {
-            /* It already failed inQuotes above so this is not in quotes.
-             */
-            currentWord += '"';
-            lastCharQuoteInNonQuoteWord = true;
-        } else if (inWord && !isWhite) {
-            currentWord += currentChar;
-            lastCharQuoteInNonQuoteWord = false;
-        } else if (lastCharQuoteInNonQuoteWord) {
-            warnx("Quote at end of token: \"%s\".", argumentsLine.c_str());
-            return false;
-        } else if (inWord) {
-            inWord = false;
-            arguments.push_back(currentWord);
-            lastCharQuoteInNonQuoteWord = false;
-            currentWord.clear();
-        } else if (lastCharClosingQuote && !isWhite) {
-            warnx("Missing space after quoted token: \"%s\".",
-                argumentsLine.c_str());
-            return false;
-        } else if (currentChar == '"') {
-            inWord = true;
-            inQuotes = true;
-            lastCharClosingQuote = false;
-        } else if (!isWhite) {
-            inWord = true;
-            inQuotes = false;
-            lastCharClosingQuote = false;
-            currentWord += currentChar;
-        } else {
-            lastCharClosingQuote = false;
-        }
-    }
-    if (inQuotes) {
-        warnx("Unclosed quote in word: \"%s\".", argumentsLine.c_str());
-        return false;
-    }
-    if (lastCharQuoteInNonQuoteWord) {
-        warnx("Quote at end of token: \"%s\".", argumentsLine.c_str());
-        return false;
-    }
-    if (inWord)
-        arguments.push_back(currentWord);
-    return true;
-}
-
 bool
 ConfigFileReader::inModule() const
 {
-    return inFiles || isCreatingModuleActions();
+    return inFiles || inRequirements || isCreatingModuleActions();
 }
 
 bool
@@ -684,13 +860,14 @@ ConfigFileReader::errorMessageNoLine(const char* format, ...)
 void
 ConfigFileReader::vErrorMessageNoLine(const char* format, va_list argumentList)
 {
-    vwarnx(format, argumentList);
-    std::cerr << getPath() << ": line " << currentLineNo << std::endl;
+    vConfigWarning(format, argumentList);
+    writeConfigWarning(
+        getPath() + ": line " + std::to_string(currentLineNo) + "\n");
 }
 
 void
 ConfigFileReader::errorMessage(
-    const std::string& line, const char* format, ...)
+    const StringSlice& line, const char* format, ...)
 {
     va_list argumentList;
     va_start(argumentList, format);
@@ -700,11 +877,11 @@ ConfigFileReader::errorMessage(
 
 void
 ConfigFileReader::vErrorMessage(
-    const std::string& line, const char* format, va_list argumentList)
+    const StringSlice& line, const char* format, va_list argumentList)
 {
-    vwarnx(format, argumentList);
-    std::cerr << getPath() << ": line " << currentLineNo << ":" << std::endl;
-    std::cerr << line << std::endl;
+    vConfigWarning(format, argumentList);
+    writeConfigWarning(getPath() + ": line " + std::to_string(currentLineNo)
+        + ":\n" + line.toString() + "\n");
 }
 
 void
@@ -720,56 +897,4 @@ ConfigFileReader::setModuleActionFlags(ModuleAction* action)
     action->setVerbose(options->verboseFlag);
     action->setInteractive(options->interactiveFlag);
 }
-
-bool
-ConfigFileReader::isAssignmentLine(const std::string& line)
-{
-    if (isEmptyLine(line) || isComment(line, 0))
-        return false;
-    /*
-     * Match a group of non-white characters at the start of a line that also
-     * cannot contain a colon characters. Then some whitespace and an equals
-     * sign. Then a group of words with optional whitespace in between them and
-     * some optionsal space at the end. Even though this method doesn't save
-     * the variable name or value, it still has to capture the words here to
-     * make sure that it follows the rules of quotations.
-     */
-    std::regex assignmentRe("^[^\\s:]+\\s+=((?:\\s*\\S+)+)\\s*$");
-    std::smatch match;
-    if (!std::regex_match(line, match, assignmentRe))
-        return false;
-    std::string valueWords = match.str(1);
-    std::vector<std::string> valueArguments;
-    return (splitArguments(valueWords, valueArguments))
-        ? valueArguments.size() == 1
-        : false;
-}
-
-bool
-ConfigFileReader::isAssignmentLine(
-    const std::string& line, std::string& name, std::string& value)
-{
-    if (isEmptyLine(line) || isComment(line, 0))
-        return false;
-    /*
-     * Match a group of non-white characters at the start of a line that also
-     * cannot contain a colon characters. Then some whitespace and an equals
-     * sign. Then a group of words with optional whitespace in between them and
-     * some optionsal space at the end. Capture the initial group, as well as
-     * the part containing all the words.
-     */
-    std::regex assignmentRe("^([^\\s:]+)\\s+=((?:\\s*\\S+)+)\\s*$");
-    std::smatch match;
-    if (!std::regex_match(line, match, assignmentRe))
-        return false;
-    name = match.str(1);
-    std::string valueWords = match.str(2);
-    std::vector<std::string> valueArguments;
-    if (!splitArguments(valueWords, valueArguments))
-        return false;
-    if (valueArguments.size() != 1)
-        return false;
-    value = valueArguments[0];
-    return true;
-}
 } /* namespace dfm */
@@ -27,17 +27,26 @@
 
 #include <err.h>
 #include <stdarg.h>
+#include <string.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "builtincommand.h"
 #include "command.h"
+#include "configlexer.h"
 #include "installaction.h"
+#include "mappedfile.h"
 #include "messageaction.h"
 #include "module.h"
+#include "moduleindex.h"
 #include "options.h"
 #include "readerenvironment.h"
 #include "removeaction.h"
@@ -45,13 +54,22 @@
 
 namespace dfm {
 
+class ModuleStream;
+
 /*
  * The default name that the program should look for in the source directory as
  * the config file.
  */
 const char CONFIG_FILE_NAME[] = "config.dfm";
-
-const char COMMENT_DELIMITER = '#';
+/* The most threads to parse a config file on at once. */
+const unsigned int MAX_PARSE_THREADS = 8;
+/*
+ * A config file smaller than this is parsed on one thread, since starting more
+ * would take longer than parsing it.
+ */
+const size_t PARALLEL_PARSE_MIN_SIZE = 256 * 1024;
+/* How many parts each parsing thread gets, so that none of them sits idle. */
+const unsigned int PARTS_PER_PARSE_THREAD = 4;
 
 class ConfigFileReader {
 public:
@@ -82,21 +100,42 @@ public:
      */
     void errorMessageNoLine(const char* format, ...);
     void vErrorMessageNoLine(const char* format, va_list argumentList);
-    void errorMessage(const std::string& line, const char* format, ...);
+    void errorMessage(const StringSlice& line, const char* format, ...);
     void vErrorMessage(
-        const std::string& line, const char* format, va_list argumentList);
+        const StringSlice& line, const char* format, va_list argumentList);
     /*
      * Read the modules in the given file and write them to the given iterator,
      * which must contain elements of type Module.
      *
+     * If the useCacheFlag option is set, then the modules are loaded from the
+     * cache in the same directory if it's up to date, and the cache is
+     * written after reading the config file otherwise.
+     *
      * Returns true on success, false on failure.
      */
     template <class OutputIterator> bool readModules(OutputIterator output);
+    /*
+     * Reads only the modules matching names, which can be patterns like on
+     * the command line, and the modules that those require, and writes them
+     * to output in config file order. The file is scanned for module headers
+     * first, so the lines of other modules aren't parsed at all, and errors
+     * in them aren't found. Names that don't match anything are skipped. The
+     * cache isn't used.
+     *
+     * Returns true on success, false on failure.
+     */
+    template <class OutputIterator>
+    bool readSelectedModules(
+        const std::vector<std::string>& names, OutputIterator output);
+
+    /* Returns the path of the cache that belongs to this config file. */
+    std::string getCachePath() const;
 
     /*
      * Adds a command with the given action and given names. It takes a list of
      * null terminated list of C strings. The last argument must be NULL or
-     * else something will go wrong.
+     * else something will go wrong. The builtin commands don't need to be
+     * added and can't be replaced this way.
      */
     void addCommand(std::function<std::shared_ptr<ModuleAction>(
                         const std::vector<std::string>&, ReaderEnvironment&)>
@@ -131,10 +170,25 @@ public:
         ReaderEnvironment& environment);
 
 private:
+    /* Reads modules one at a time with the same parsing as readModules(). */
+    friend class ModuleStream;
+
+    /*
+     * Makes a reader that parses part of the file of another reader, with
+     * copies of its variables and commands, on another thread.
+     */
+    ConfigFileReader(const std::string& path,
+        std::shared_ptr<DfmOptions> options,
+        const ReaderEnvironment& environment,
+        const std::vector<Command>& commands);
+
     /* The path to the config file. */
     std::string path;
-    /* The reader to open path with. */
-    std::ifstream reader;
+    /*
+     * The contents of the config file. Lines are handed to the lexer as
+     * slices of it, so they are never copied.
+     */
+    MappedFile file;
     /*
      * The options for the program to be used when reading this file. These are
      * meant to be read using getopt and passed to this object.
@@ -160,6 +214,13 @@ private:
      * are processed as files to intall
      */
     bool inFiles = false;
+    /* How the files being read are installed, set by the header above them. */
+    InstallMode fileInstallMode = COPY_INSTALL_MODE;
+    /*
+     * Whether or not the reader is reading the names of modules that the
+     * current one requires.
+     */
+    bool inRequirements = false;
     /*
      * Whether or not the reader is in a module install which determines what
      * command lines are used for.
@@ -178,7 +239,7 @@ private:
     /*
      * Pointer to a current module being constructed. Set to nullptr when not
      * currently in a module and is meant to be deleted when the module is
-     * copied to the output.
+     * moved to the output.
      */
     Module* currentModule = nullptr;
     /*
@@ -187,144 +248,188 @@ private:
      */
     bool inShell = false;
     /* The current action to append shell commands to. */
-    ShellAction* currentShellAction = nullptr;
+    std::shared_ptr<ShellAction> currentShellAction;
+    /*
+     * The timeout in seconds given for the next shell command, or 0 if there
+     * wasn't one.
+     */
+    unsigned int pendingTimeout = 0;
     /*
      * The current line number of the reader, meant to be used with error
      * messages.
      */
     int currentLineNo = 1;
+
+    /* Where a module is in the file, found without parsing it. */
+    struct ModuleLocation {
+        std::string name;
+        /* The offsets of its header line and the end of its last line. */
+        size_t start = 0;
+        size_t end = 0;
+        /* The line number of its header line. */
+        int lineNo = 1;
+    };
+    /*
+     * The line that each module read so far started on, to catch two modules
+     * with the same name.
+     */
+    std::unordered_map<std::string, int> moduleLines;
     /*
-     * The list of commands, which is checked against when processing a normal
-     * command. It looks through these commands in order, so higher priority
-     * commands should be first and if two commands share a name the one first
-     * will be executed.
+     * The commands added with addCommand(), which are checked after the
+     * builtin commands when processing a normal command. It looks through
+     * these commands in order, so higher priority commands should be first
+     * and if two commands share a name the one first will be executed.
      */
     std::vector<Command> commands;
 
     /*
-     * This is the function that determines which commands can be run and what
-     * kind of arguments checking they require.
+     * Parses the config file and writes the modules to output. This is what
+     * readModules() does when it doesn't use the cache.
+     *
+     * Returns true on success, false on failure.
      */
-    void addDefaultCommands();
+    template <class OutputIterator> bool parseModules(OutputIterator output);
     /*
-     * Sets some initial variables that are required for normal functioning to
-     * work to sensible defaults.
-     */
-    void addDefaultVariables();
-    /* Equivalent to line.length() == 0. */
-    bool isEmptyLine(const std::string& line) const;
-    /*
-     * Tests if the given line is a comment. A line is a comment if the first
-     * character in the line is COMMENT_DELIMITER, or if any of the next
-     * expectedIndents characters are COMMENT_DELIMITER. The reason for this is
-     * to embed the COMMENT_DELIMITER character in commands and in shell
-     * commands.
+     * Finds where every module is if the file is big enough to be worth
+     * parsing on more than one thread, and sets threadCount to how many to
+     * use. A file that has an error before its first module or a module
+     * defined twice isn't split, so that its errors are found in file order.
      *
-     * Returns whether or not the given line is a comment.
+     * Returns true if the modules can be parsed in parallel, false otherwise.
      */
-    bool isComment(
-        const std::string& line, unsigned int expectedIndents) const;
-    /* Returns the number of '\t' characters at the start of the line. */
-    int indentCount(const std::string& line) const;
+    bool splitModules(
+        std::vector<ModuleLocation>& locations, unsigned int& threadCount);
     /*
-     * Gets the expected number of indents based on the current state of the
-     * reader. Being in a shell means it expects two, being in a module install
-     * or uninstall makes it 1, and anything else makes it 0.
+     * Parses runs of whole modules on threadCount threads at once and sets
+     * partModules to the modules of each run, in file order. The warnings of
+     * each run are given in file order after they're done, up to the first
+     * run with an error, so they're the same as when parsing on one thread.
      *
-     * Returns the number of expected indentations based on the reader state.
+     * Returns true on success, false on failure.
      */
-    int getExpectedIndents() const;
+    bool parseModulesInParallel(const std::vector<ModuleLocation>& locations,
+        unsigned int threadCount,
+        std::vector<std::vector<Module>>& partModules);
     /*
-     * Removes indents indents from the start of line and returns it.
+     * Parses the lines from current to end, which start at currentLineNo,
+     * and finishes the last module. The reader state must already be set up
+     * for the first line.
      *
-     * Returns a new string with indents indents stripped from it.
+     * Returns true on success, false on failure.
      */
-    std::string stripIndents(const std::string& line, int indents);
+    template <class OutputIterator>
+    bool parseLines(
+        const char* current, const char* end, OutputIterator output);
     /*
-     * Tests to see if line assigns a variable. A line assigns a variable if
-     * line begins with no whitespace, the first token is a valid variable
-     * name, the second token is an equals sign, and the third is either a
-     * normal string or a quoted string.
+     * Parses the line starting at current, which ends before end, and moves
+     * current to the start of the next line.
      *
-     * Returns whether or not line is a line that assigns a variable.
+     * Returns true on success, false on failure.
      */
-    bool isAssignmentLine(const std::string& line);
-    bool isAssignmentLine(
-        const std::string& line, std::string& name, std::string& value);
+    template <class OutputIterator>
+    bool parseLine(const char*& current, const char* end, OutputIterator output);
     /*
-     * Tests to see if the line starts a module and sets moduleName to the name
-     * if this is so. These don't check if the line is blank or a comment and
-     * process as is because it is assumes the checking was already done.
-     *
-     * If it does match the module syntax, stores the module name in line. Does
-     * not affect line if the line is not a module line.
-     *
-     * Returns whether or not line matches the syntax for a new module line.
+     * Finishes the current shell action and module after the last line,
+     * writing the module to output.
      */
-    bool isModuleLine(const std::string& line, std::string& moduleName);
+    template <class OutputIterator> void finishModule(OutputIterator output);
     /*
-     * Tests to see if the line starts a module and sets moduleName to the name
-     * if this is so. These don't check if the line is blank or a comment and
-     * process as is because it is assumes the checking was already done.
+     * Gives an error if the last line left something waiting for a line that
+     * never came, like a timeout without a shell command.
      *
-     * Returns whether or not line matches the syntax for a new module line.
+     * Returns true if nothing was left, false otherwise.
      */
-    bool isModuleLine(const std::string& line);
+    bool verifyNothingPending();
     /*
-     * Tests line to see if it reprsents a line that starts install actions.
+     * Sets any variables at the start of the file and finds where every
+     * module is by only looking at lines without indentation. Modules with
+     * the same name are an error like when parsing.
      *
-     * Returns if the line starts with install: with optional whitespace.
+     * Returns true on success, false on failure.
+     */
+    bool scanModules(std::vector<ModuleLocation>& locations);
+    /* Resets the state for reading the file from the first line. */
+    void startParsing();
+    /* Resets the state for reading a module, but not the variables. */
+    void resetModuleState();
+    /*
+     * Creates the key for the cache, which describes everything other than
+     * the config file that affects the modules read from it.
      */
-    bool isInstallLine(const std::string& line);
+    std::string createCacheKey() const;
     /*
-     * Tests line to see if it represents a line that uninstalls.
+     * Loads modules from the cache into modules and sets the variables from
+     * it. Does nothing if the cache is missing or out of date.
      *
-     * Returns whether or not line matches the syntax for an uninstall line.
+     * Returns true if the cache was used, false otherwise.
      */
-    bool isUninstallLine(const std::string& line);
+    bool loadCachedModules(std::vector<Module>& modules);
+    /* Writes the given modules to the cache, ignoring any failure. */
+    void saveCachedModules(const std::vector<Module>& modules);
+
     /*
-     * Tests line to see if it represents a line that starts update actions.
+     * Sets some initial variables that are required for normal functioning to
+     * work to sensible defaults.
+     */
+    void addDefaultVariables();
+    /*
+     * Gets the expected number of indents based on the current state of the
+     * reader. Being in a shell means it expects two, being in a module install
+     * or uninstall makes it 1, and anything else makes it 0.
      *
-     * Returns if the line starts with update: with optional whitespace.
+     * Returns the number of expected indentations based on the reader state.
      */
-    bool isUpdateLine(const std::string& line);
+    int getExpectedIndents() const;
     /*
-     * Tests commandName to see if it's a command that should activate shell
-     * action.
+     * Sets the timeout for the next shell command from the arguments of a
+     * timeout command.
      *
-     * Returns if commandName represents a recognized command.
+     * Returns true on success, false on failure.
      */
-    bool isShellCommand(const std::string& commandName);
+    bool processTimeout(const ConfigLexer& lexer,
+        const std::vector<ConfigLexer::Argument>& arguments);
     /* Processing commands that affect object state. */
-    void addShellAction(const std::string& line);
+    void addShellAction(const StringSlice& command);
     /* Behavior changes if install or uninstall. */
     void flushShellAction();
     /*
-     * Assumes that line represents an assignment. Calls the correct variable
-     * methods on environment that assigns the variable values correctly.
+     * Executes command or starts new shell.
      *
-     * Returns true if the line was well formed and the variable was correctly
-     * set, false otherwise.
+     * The line is split after one indent. The first token must be a word with
+     * no spaces. Each remaining token can either be a word on its own, or a
+     * string surrounded by double-quote characters, see
+     * ConfigLexer::lexArguments().
+     *
+     * Returns true on success, false on failure.
      */
-    bool processLineAsAssignment(const std::string& line);
+    bool processLineAsCommand(const ConfigLexer& lexer);
     /*
-     * Executes command or starts new shell.
+     * Executes the command called commandName with the given arguments, which
+     * is builtin if it's one of the builtin commands and is looked up in the
+     * added commands otherwise.
+     */
+    bool processCommand(BuiltinCommand builtin, const std::string& commandName,
+        const std::vector<std::string>& arguments);
+    bool processLineAsFile(const ConfigLexer& lexer);
+    /*
+     * Replaces the ${name} references in text with the values of the
+     * variables, leaving references to variables that aren't set alone, and
+     * gives a warning if a reference isn't closed or has no name. Text
+     * without any is left alone without being looked at again.
      *
-     * Split given line after the given number of indents. The first token must
-     * be a word with no spaces. Each remaining token can either be a word on
-     * its own, or a string surrounded by double-quote characters. Any double
-     * quote characters on the inside will be part of a token. If the command
-     * is successfully parsed, then the command is stored in command. The
-     * arguments vector is cleared regardless, and any arguments are added to
-     * it.
+     * Returns true on success, false on failure.
+     */
+    bool expandVariables(std::string& text) const;
+    /*
+     * Sets the variable assigned by header, whose value can refer to the
+     * variables set before it, and gives an error on line if it can't.
      *
      * Returns true on success, false on failure.
      */
-    bool processLineAsCommand(const std::string& line);
-    /* Executes command string with given arguments. */
-    bool processCommand(const std::string& commandName,
-        const std::vector<std::string>& arguments);
-    bool processLineAsFile(const std::string& line);
+    bool assignVariable(
+        const ConfigLexer::Header& header, const StringSlice& line);
+    /* Adds every module named on the line as a requirement. */
+    bool processLineAsRequirements(const ConfigLexer& lexer);
 
     /*
      * If the reader is in a module install or uninstall, finishes the module
@@ -338,6 +443,10 @@ private:
      * forget to do so.
      */
     void startNewModule(const std::string& name);
+    /* Changes to files that are installed with the given mode. */
+    void changeToFiles(InstallMode installMode);
+    /* Changes to names of modules that the current one requires. */
+    void changeToRequirements();
     /* Changes to actions representing install actions. */
     void changeToInstall();
     /* Changes to actions representing uninstall actions. */
@@ -362,48 +471,7 @@ private:
      * likely fail because of a malformed line.
      */
     template <class OutputIterator>
-    bool processLine(const std::string& line, OutputIterator output);
-
-    /*
-     * Matches a string entirely to whitespace. This could be implement with a
-     * regex or the isspace function, depedning on what you want to count as
-     * whitespace.
-     *
-     * Returns whether the whole string is whitespace, returns false for an
-     * empty string.
-     */
-    static bool isWhiteSpace(const std::string& string);
-    static bool isWhiteSpace(const char* string);
-    /* The same as above, except for single characters. */
-    static bool isWhiteSpace(char c);
-
-    /*
-     * Takes the given string containing arguments and extracts the arguments
-     * from them according to the rules of quotations. A token may be
-     * surrounded by quotes on its own, which allow for whitespace inside.
-     * Quotes are allowed in the middle of tokens, but don't make anything
-     * literal. Quotes are not allowed as the first or last character of a
-     * token. To do that, create a quoted string with an escaped quote
-     * character with \".
-     *
-     * This function takes a string that has been stripped of the command
-     * portion. If you don't take out the command portion first, it will return
-     * it as an argument.
-     *
-     * Clears the given vector regardless of any arguments found or any errors
-     * encountered. Stores any found arguments in the vector as it goes.
-     *
-     * In quotations, quote characters are escaped as \", backslash characters
-     * are escaped as \\.
-     *
-     * This used to be done through a regex, and it worked, but I wanted to
-     * give more detailed error messages like unclosed quotation mark. It
-     * wasn't worth it and I hate this.
-     *
-     * Returns true on success, false on failure.
-     */
-    bool splitArguments(
-        const std::string& argumentsLine, std::vector<std::string>& arguments);
+    bool processLine(const StringSlice& line, OutputIterator output);
 
     bool inModule() const;
     bool isCreatingModuleActions() const;
@@ -424,29 +492,115 @@ ConfigFileReader::readModules(OutputIterator output)
         warnx("Attempting to read from non-open file reader");
         return false;
     }
+    if (!options->useCacheFlag)
+        return parseModules(output);
 
-    currentLineNo = 1;
-    inVariables = true;
-    inFiles = false;
-    inModuleInstall = false;
-    inModuleUninstall = false;
-    inModuleUpdate = -false;
-    currentModule = nullptr;
-    inShell = false;
-    currentShellAction = nullptr;
+    /* Modules loaded from the cache are made in an arena too. */
+    environment.setArena(std::make_shared<Arena>());
+    /*
+     * The modules have to be looked at to write them to the cache, which
+     * can't be done through output.
+     */
+    std::vector<Module> modules;
+    if (!loadCachedModules(modules)) {
+        if (!parseModules(std::back_inserter(modules)))
+            return false;
+        saveCachedModules(modules);
+    }
+    std::move(modules.begin(), modules.end(), output);
+    return true;
+}
 
-    bool noErrors = true;
-    std::string line;
-    /* Don't read a line if processing the last line wasn't successful. */
-    while (noErrors && getline(reader, line)) {
-        noErrors = processLine<OutputIterator>(line, output);
-        if (noErrors)
-            currentLineNo++;
+template <class OutputIterator>
+bool
+ConfigFileReader::readSelectedModules(
+    const std::vector<std::string>& names, OutputIterator output)
+{
+    if (!isOpen()) {
+        warnx("Attempting to read from non-open file reader");
+        return false;
     }
-    if (inShell)
-        flushShellAction();
-    if (inModule())
-        flushModule(output);
+    environment.setArena(std::make_shared<Arena>());
+    std::vector<ModuleLocation> locations;
+    if (!scanModules(locations)) {
+        errorMessageNoLine(
+            "Failed to read config file %s.", getPath().c_str());
+        return false;
+    }
+    std::vector<std::string> locationNames;
+    for (const auto& location : locations)
+        locationNames.push_back(location.name);
+    ModuleIndex index(locationNames);
+
+    std::vector<bool> isSelected(locations.size(), false);
+    std::vector<int> unparsed;
+    auto select = [&isSelected, &unparsed](int location) {
+        if (!isSelected[location]) {
+            isSelected[location] = true;
+            unparsed.push_back(location);
+        }
+    };
+    for (const auto& name : names) {
+        for (int location : index.findMatchingModules(name))
+            select(location);
+    }
+    std::vector<std::pair<int, Module>> parsedModules;
+    while (!unparsed.empty()) {
+        const ModuleLocation& location = locations[unparsed.back()];
+        int locationIndex = unparsed.back();
+        unparsed.pop_back();
+        const char* data = file.getData();
+        std::vector<Module> modules;
+        inVariables = false;
+        resetModuleState();
+        currentLineNo = location.lineNo;
+        if (!parseLines(data + location.start, data + location.end,
+                std::back_inserter(modules))) {
+            errorMessageNoLine(
+                "Failed to read config file %s.", getPath().c_str());
+            return false;
+        }
+        for (auto& module : modules) {
+            for (const auto& requirement : module.getRequirements()) {
+                int requiredLocation = index.findModule(requirement);
+                if (requiredLocation != -1)
+                    select(requiredLocation);
+            }
+            parsedModules.push_back(
+                std::make_pair(locationIndex, std::move(module)));
+        }
+    }
+    std::sort(parsedModules.begin(), parsedModules.end(),
+        [](const std::pair<int, Module>& first,
+            const std::pair<int, Module>& second) {
+            return first.first < second.first;
+        });
+    for (auto& parsedModule : parsedModules) {
+        *output = std::move(parsedModule.second);
+        output++;
+    }
+    return true;
+}
+
+template <class OutputIterator>
+bool
+ConfigFileReader::parseModules(OutputIterator output)
+{
+    std::vector<ModuleLocation> locations;
+    unsigned int threadCount = 1;
+    if (splitModules(locations, threadCount)) {
+        std::vector<std::vector<Module>> partModules;
+        if (!parseModulesInParallel(locations, threadCount, partModules))
+            return false;
+        for (auto& modules : partModules) {
+            std::move(modules.begin(), modules.end(), output);
+            std::vector<Module>().swap(modules);
+        }
+        return true;
+    }
+    startParsing();
+    bool noErrors = parseLines(
+        file.getData(), file.getData() + file.getSize(), output);
     if (!noErrors)
         errorMessageNoLine(
             "Failed to read config file %s.", getPath().c_str());
@@ -455,35 +609,90 @@ ConfigFileReader::readModules(OutputIterator output)
 
 template <class OutputIterator>
 bool
-ConfigFileReader::processLine(const std::string& line, OutputIterator output)
+ConfigFileReader::parseLines(
+    const char* current, const char* end, OutputIterator output)
 {
-    if (isEmptyLine(line))
+    bool noErrors = true;
+    /*
+     * Don't read a line if processing the last line wasn't successful. Like
+     * getline, the last line doesn't need a newline at the end of it.
+     */
+    while (noErrors && current < end)
+        noErrors = parseLine(current, end, output);
+    finishModule(output);
+    return noErrors && verifyNothingPending();
+}
+
+template <class OutputIterator>
+bool
+ConfigFileReader::parseLine(
+    const char*& current, const char* end, OutputIterator output)
+{
+    const char* lineEnd =
+        static_cast<const char*>(memchr(current, '\n', end - current));
+    if (lineEnd == nullptr)
+        lineEnd = end;
+    StringSlice line(current, lineEnd - current);
+    current = lineEnd + 1;
+    if (!processLine<OutputIterator>(line, output))
+        return false;
+    currentLineNo++;
+    return true;
+}
+
+template <class OutputIterator>
+void
+ConfigFileReader::finishModule(OutputIterator output)
+{
+    if (inShell)
+        flushShellAction();
+    if (inModule())
+        flushModule(output);
+}
+
+template <class OutputIterator>
+bool
+ConfigFileReader::processLine(const StringSlice& line, OutputIterator output)
+{
+    ConfigLexer lexer(line);
+    if (lexer.isEmpty())
         return true;
-    int expectedIndents = getExpectedIndents();
-    if (isComment(line, expectedIndents))
+    if (lexer.isComment(getExpectedIndents()))
         return true;
 
-    int indents = indentCount(line);
+    int indents = lexer.getIndents();
+    /*
+     * Every line without indentation ends up being checked as a header or an
+     * assignment, so lex it once here.
+     */
+    ConfigLexer::Header header;
+    if (indents == 0)
+        lexer.lexHeader(header, inVariables);
 
     if (inVariables) {
-        std::string variableName;
-        std::string variableValue;
-        if (isAssignmentLine(line, variableName, variableValue)) {
-            environment.setVariable(variableName, variableValue);
-            return true;
-        } else
+        if (header.isAssignment)
+            return assignVariable(header, line);
+        else
             inVariables = false;
     }
     if (inShell) {
         if (indents >= 2) {
-            addShellAction(line);
+            addShellAction(lexer.stripIndents(2));
             return true;
         } else
             flushShellAction();
     }
     if (inFiles) {
         if (indents == 1)
-            return processLineAsFile(line);
+            return processLineAsFile(lexer);
+        else if (indents > 1) {
+            errorMessage(line, "Unexpected indentation.");
+            return false;
+        }
+    }
+    if (inRequirements) {
+        if (indents == 1)
+            return processLineAsRequirements(lexer);
         else if (indents > 1) {
             errorMessage(line, "Unexpected indentation.");
             return false;
@@ -491,13 +700,17 @@ ConfigFileReader::processLine(const std::string& line, OutputIterator output)
     }
     if (isCreatingModuleActions()) {
         if (indents == 1)
-            return processLineAsCommand(line);
+            return processLineAsCommand(lexer);
         else if (indents > 1) {
             errorMessage(line, "Unexpected indentation.");
             return false;
         }
     }
-    if (isInstallLine(line)) {
+    if (pendingTimeout > 0) {
+        errorMessage(line, "Timeout isn't followed by a shell command.");
+        return false;
+    }
+    if (header.type == ConfigLexer::INSTALL_HEADER) {
         if (!inModule()) {
             errorMessage(line, "Install without named module.");
             return false;
@@ -505,7 +718,7 @@ ConfigFileReader::processLine(const std::string& line, OutputIterator output)
         changeToInstall();
         return true;
     }
-    if (isUninstallLine(line)) {
+    if (header.type == ConfigLexer::UNINSTALL_HEADER) {
         if (!inModule()) {
             errorMessage(line, "Uninstall without named module.");
             return false;
@@ -513,7 +726,7 @@ ConfigFileReader::processLine(const std::string& line, OutputIterator output)
         changeToUninstall();
         return true;
     }
-    if (isUpdateLine(line)) {
+    if (header.type == ConfigLexer::UPDATE_HEADER) {
         if (!inModule()) {
             errorMessage(line, "Update without named module.");
             return false;
@@ -521,11 +734,36 @@ ConfigFileReader::processLine(const std::string& line, OutputIterator output)
         changeToUpdate();
         return true;
     }
-    std::string moduleName;
-    if (isModuleLine(line, moduleName)) {
+    if (header.type == ConfigLexer::SYMLINK_HEADER
+        || header.type == ConfigLexer::HARDLINK_HEADER) {
+        if (!inModule()) {
+            errorMessage(line, "Links without named module.");
+            return false;
+        }
+        changeToFiles((header.type == ConfigLexer::SYMLINK_HEADER)
+                ? SYMLINK_INSTALL_MODE
+                : HARDLINK_INSTALL_MODE);
+        return true;
+    }
+    if (header.type == ConfigLexer::REQUIRES_HEADER) {
+        if (!inModule()) {
+            errorMessage(line, "Requirements without named module.");
+            return false;
+        }
+        changeToRequirements();
+        return true;
+    }
+    if (header.type == ConfigLexer::MODULE_HEADER) {
+        std::string name = header.moduleName.toString();
+        auto inserted = moduleLines.insert(std::make_pair(name, currentLineNo));
+        if (!inserted.second) {
+            errorMessage(line, "Module \"%s\" is already defined on line %d.",
+                name.c_str(), inserted.first->second);
+            return false;
+        }
         if (inModule())
             flushModule(output);
-        startNewModule(moduleName);
+        startNewModule(name);
         return true;
     }
     errorMessage(line, "Unable to process line.");
@@ -536,9 +774,11 @@ template <class OutputIterator>
 void
 ConfigFileReader::flushModule(OutputIterator output)
 {
-    *output = *currentModule;
+    *output = std::move(*currentModule);
     delete currentModule;
+    currentModule = nullptr;
     inFiles = false;
+    inRequirements = false;
     inModuleInstall = false;
     inModuleUninstall = false;
     inModuleUpdate = false;
@@ -26,11 +26,13 @@
 
 #include <err.h>
 
+#include <utility>
+
 namespace dfm {
 
 ConfigFileWriter::ConfigFileWriter(
-    const std::string& path, const std::vector<Module> modules)
-    : path(path), modules(modules)
+    const std::string& path, std::vector<Module> modules)
+    : path(path), modules(std::move(modules))
 {
     writer.open(path);
 }
@@ -89,8 +91,8 @@ ConfigFileWriter::getModules() const
 }
 
 void
-ConfigFileWriter::setModules(const std::vector<Module>& modules)
+ConfigFileWriter::setModules(std::vector<Module> modules)
 {
-    this->modules = modules;
+    this->modules = std::move(modules);
 }
 } /* namespace dfm */
@@ -35,8 +35,8 @@ namespace dfm {
 
 class ConfigFileWriter {
 public:
-    ConfigFileWriter(
-        const std::string& path, const std::vector<Module> modules);
+    /* Takes ownership of the modules, so pass them with std::move. */
+    ConfigFileWriter(const std::string& path, std::vector<Module> modules);
     ~ConfigFileWriter();
 
     bool writeModules();
@@ -46,7 +46,7 @@ public:
     const std::string& getPath() const;
     void setPath(const std::string& path);
     const std::vector<Module>& getModules() const;
-    void setModules(const std::vector<Module>& modules);
+    void setModules(std::vector<Module> modules);
 
 private:
     std::ofstream writer;
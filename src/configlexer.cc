@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "configlexer.h"
+
+#include <assert.h>
+#include <ctype.h>
+
+#include "util.h"
+
+namespace dfm {
+
+/*
+ * Whitespace is whatever isspace says it is, which is the same as what \s
+ * matched back when lines were classified with regexes.
+ */
+static bool
+isWhiteSpace(char c)
+{
+    return isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+ConfigLexer::Argument::Argument()
+{
+}
+
+ConfigLexer::Argument::Argument(const StringSlice& text, bool hasEscapes)
+    : text(text), escapes(hasEscapes)
+{
+}
+
+const StringSlice&
+ConfigLexer::Argument::getText() const
+{
+    return text;
+}
+
+bool
+ConfigLexer::Argument::hasEscapes() const
+{
+    return escapes;
+}
+
+std::string
+ConfigLexer::Argument::toString() const
+{
+    if (!escapes)
+        return text.toString();
+    std::string unescaped;
+    unescaped.reserve(text.getLength());
+    for (size_t i = 0; i < text.getLength(); i++) {
+        if (text[i] != '\\') {
+            unescaped += text[i];
+            continue;
+        }
+        /*
+         * The scanner doesn't allow a quoted word to end in an unpaired
+         * backslash, so there's always another character here.
+         */
+        i++;
+        if (text[i] == '"' || text[i] == '\\')
+            unescaped += text[i];
+    }
+    return unescaped;
+}
+
+ConfigLexer::ConfigLexer(const StringSlice& line) : line(line)
+{
+    while (indents < line.getLength() && line[indents] == '\t')
+        indents++;
+}
+
+const StringSlice&
+ConfigLexer::getLine() const
+{
+    return line;
+}
+
+int
+ConfigLexer::getIndents() const
+{
+    return indents;
+}
+
+bool
+ConfigLexer::isEmpty() const
+{
+    return line.isEmpty();
+}
+
+bool
+ConfigLexer::isComment(unsigned int expectedIndents) const
+{
+    return indents < line.getLength() && line[indents] == COMMENT_DELIMITER
+        && indents <= expectedIndents + 1;
+}
+
+StringSlice
+ConfigLexer::stripIndents(int indents) const
+{
+    assert(indents >= 0);
+    size_t indentsToErase = (static_cast<size_t>(indents) < this->indents)
+        ? static_cast<size_t>(indents)
+        : this->indents;
+    return line.subslice(indentsToErase);
+}
+
+void
+ConfigLexer::lexHeader(Header& header, bool lexAssignment) const
+{
+    header = Header();
+    size_t length = line.getLength();
+    if (length == 0 || isWhiteSpace(line[0]) || line[0] == COMMENT_DELIMITER)
+        return;
+
+    enum AssignmentState { IN_NAME, AFTER_NAME, IN_VALUE, NOT_ASSIGNMENT };
+    AssignmentState state = (lexAssignment) ? IN_NAME : NOT_ASSIGNMENT;
+    size_t nameEnd = 0;
+    size_t equalsIndex = 0;
+    std::vector<Argument> values;
+    ArgumentScanner scanner(line.getData(), values);
+    /*
+     * The module name ends at the last non-white character before the colon
+     * that must be the last non-white character on the line. Both of these
+     * start out as length to mean that they haven't been found.
+     */
+    size_t lastNonWhite = length;
+    size_t previousNonWhite = length;
+
+    for (size_t i = 0; i < length; i++) {
+        char currentChar = line[i];
+        bool isWhite = isWhiteSpace(currentChar);
+        if (!isWhite) {
+            previousNonWhite = lastNonWhite;
+            lastNonWhite = i;
+        }
+        switch (state) {
+        case IN_NAME:
+            if (isWhite) {
+                nameEnd = i;
+                state = AFTER_NAME;
+            } else if (currentChar == ':')
+                state = NOT_ASSIGNMENT;
+            break;
+        case AFTER_NAME:
+            if (currentChar == '=') {
+                equalsIndex = i;
+                state = IN_VALUE;
+            } else if (!isWhite)
+                state = NOT_ASSIGNMENT;
+            break;
+        case IN_VALUE:
+            scanner.feed(i);
+            break;
+        case NOT_ASSIGNMENT:
+            break;
+        }
+    }
+
+    /* The value must have at least one non-white character. */
+    if (state == IN_VALUE && lastNonWhite > equalsIndex) {
+        StringSlice valueWords =
+            line.subslice(equalsIndex + 1, lastNonWhite - equalsIndex);
+        if (scanner.finish(length, valueWords) && values.size() == 1) {
+            header.isAssignment = true;
+            header.variableName = line.subslice(0, nameEnd);
+            header.variableValue = values[0];
+        }
+    }
+
+    if (lastNonWhite == length || line[lastNonWhite] != ':'
+        || previousNonWhite == length)
+        return;
+    header.moduleName = line.subslice(0, previousNonWhite + 1);
+    if (header.moduleName == "install")
+        header.type = INSTALL_HEADER;
+    else if (header.moduleName == "uninstall")
+        header.type = UNINSTALL_HEADER;
+    else if (header.moduleName == "update")
+        header.type = UPDATE_HEADER;
+    else if (header.moduleName == "link")
+        header.type = SYMLINK_HEADER;
+    else if (header.moduleName == "hardlink")
+        header.type = HARDLINK_HEADER;
+    else if (header.moduleName == "requires")
+        header.type = REQUIRES_HEADER;
+    else
+        header.type = MODULE_HEADER;
+}
+
+ConfigLexer::CommandStatus
+ConfigLexer::lexCommand(CommandLine& command) const
+{
+    command = CommandLine();
+    StringSlice body = stripIndents(1);
+    size_t length = body.getLength();
+    if (length == 0 || isWhiteSpace(body[0]))
+        return NO_COMMAND;
+
+    ArgumentScanner scanner(body.getData(), command.arguments);
+    size_t nameEnd = length;
+    size_t shellStart = length;
+    bool inName = true;
+    for (size_t i = 0; i < length; i++) {
+        char currentChar = body[i];
+        bool isWhite = isWhiteSpace(currentChar);
+        if (inName) {
+            if (!isWhite)
+                continue;
+            nameEnd = i;
+            inName = false;
+        }
+        /*
+         * The rest of the line used to be matched with ".*", which doesn't
+         * match line terminators, so a stray one means there's no command.
+         */
+        if (currentChar == '\n' || currentChar == '\r')
+            return NO_COMMAND;
+        if (shellStart == length && !isWhite)
+            shellStart = i;
+        scanner.feed(i);
+    }
+
+    command.name = body.subslice(0, nameEnd);
+    StringSlice rest = body.subslice(nameEnd);
+    if (!scanner.finish(length, rest))
+        return BAD_ARGUMENTS;
+    if (!rest.isEmpty()) {
+        command.hasShellText = true;
+        command.shellText = body.subslice(shellStart);
+    }
+    return COMMAND_OK;
+}
+
+bool
+ConfigLexer::lexArguments(std::vector<Argument>& arguments) const
+{
+    return lexArguments(line, indents, arguments);
+}
+
+bool
+ConfigLexer::lexArguments(
+    const StringSlice& text, size_t start, std::vector<Argument>& arguments)
+{
+    arguments.clear();
+    ArgumentScanner scanner(text.getData(), arguments);
+    for (size_t i = start; i < text.getLength(); i++)
+        scanner.feed(i);
+    return scanner.finish(text.getLength(), text);
+}
+
+ConfigLexer::ArgumentScanner::ArgumentScanner(
+    const char* data, std::vector<Argument>& arguments)
+    : data(data), arguments(arguments)
+{
+}
+
+void
+ConfigLexer::ArgumentScanner::feed(size_t index)
+{
+    if (error != NO_ERROR)
+        return;
+    char currentChar = data[index];
+    bool isWhite = isWhiteSpace(currentChar);
+    /*
+     * This is the same state machine that splitArguments used, except that
+     * words are remembered by where they start instead of being built up one
+     * character at a time.
+     */
+    if (inWord && inQuotes && currentChar == '"') {
+        if (!lastCharEscape) {
+            if (wordLength == 0)
+                emptyStringCount++;
+            inQuotes = false;
+            inWord = false;
+            lastCharClosingQuote = true;
+            arguments.push_back(Argument(
+                StringSlice(data + wordStart, index - wordStart),
+                wordHasEscapes));
+        } else {
+            lastCharEscape = false;
+            wordLength++;
+        }
+    } else if (inWord && inQuotes && currentChar == '\\') {
+        wordHasEscapes = true;
+        if (!lastCharEscape)
+            lastCharEscape = true;
+        else {
+            lastCharEscape = false;
+            wordLength++;
+        }
+    } else if (inWord && inQuotes && lastCharEscape) {
+        /* It's escaped so don't add it to the word. */
+        lastCharEscape = false;
+    } else if (inWord && inQuotes) {
+        wordLength++;
+    } else if (inWord && currentChar == '"') {
+        lastCharQuoteInNonQuoteWord = true;
+    } else if (inWord && !isWhite) {
+        lastCharQuoteInNonQuoteWord = false;
+    } else if (lastCharQuoteInNonQuoteWord) {
+        error = QUOTE_AT_END_ERROR;
+    } else if (inWord) {
+        inWord = false;
+        arguments.push_back(Argument(
+            StringSlice(data + wordStart, index - wordStart), false));
+    } else if (lastCharClosingQuote && !isWhite) {
+        error = MISSING_SPACE_ERROR;
+    } else if (currentChar == '"') {
+        inWord = true;
+        inQuotes = true;
+        lastCharClosingQuote = false;
+        wordStart = index + 1;
+        wordHasEscapes = false;
+        wordLength = 0;
+    } else if (!isWhite) {
+        inWord = true;
+        inQuotes = false;
+        lastCharClosingQuote = false;
+        wordStart = index;
+    } else {
+        lastCharClosingQuote = false;
+    }
+}
+
+bool
+ConfigLexer::ArgumentScanner::finish(size_t end, const StringSlice& text)
+{
+    if (error == NO_ERROR) {
+        if (inQuotes)
+            error = UNCLOSED_QUOTE_ERROR;
+        else if (lastCharQuoteInNonQuoteWord)
+            error = QUOTE_AT_END_ERROR;
+        else if (inWord)
+            arguments.push_back(
+                Argument(StringSlice(data + wordStart, end - wordStart), false));
+    }
+
+    if (error == NO_ERROR && emptyStringCount == 0)
+        return true;
+    std::string textString = text.toString();
+    for (int i = 0; i < emptyStringCount; i++)
+        configWarning(
+            "Using empty string as argument: \"%s\".", textString.c_str());
+    switch (error) {
+    case NO_ERROR:
+        return true;
+    case QUOTE_AT_END_ERROR:
+        configWarning(
+            "Quote at end of token: \"%s\".", textString.c_str());
+        break;
+    case MISSING_SPACE_ERROR:
+        configWarning(
+            "Missing space after quoted token: \"%s\".", textString.c_str());
+        break;
+    case UNCLOSED_QUOTE_ERROR:
+        configWarning(
+            "Unclosed quote in word: \"%s\".", textString.c_str());
+        break;
+    }
+    return false;
+}
+} /* namespace dfm */
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef CONFIG_LEXER_H
+#define CONFIG_LEXER_H
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+#include "stringslice.h"
+
+namespace dfm {
+
+const char COMMENT_DELIMITER = '#';
+
+/*
+ * Breaks a single line of a config file into the pieces that the reader cares
+ * about. The lexer never copies the line, everything it finds is handed out as
+ * a slice of it, so the line has to outlive the lexer and anything it returns.
+ *
+ * Counting the indents happens when the lexer is created, and each of the lex
+ * methods looks at the rest of the line exactly once. Which one should be
+ * called depends on the state of the reader, so that's left to the reader.
+ */
+class ConfigLexer {
+public:
+    enum HeaderType {
+        NO_HEADER,
+        MODULE_HEADER,
+        INSTALL_HEADER,
+        UNINSTALL_HEADER,
+        UPDATE_HEADER,
+        SYMLINK_HEADER,
+        HARDLINK_HEADER,
+        REQUIRES_HEADER
+    };
+
+    /*
+     * A single argument on a line. Quoted arguments don't include the quotes,
+     * but they do include any backslashes used for escaping, which are only
+     * removed when converting it to a string.
+     */
+    class Argument {
+    public:
+        Argument();
+        Argument(const StringSlice& text, bool hasEscapes);
+
+        const StringSlice& getText() const;
+        bool hasEscapes() const;
+        /*
+         * Returns the argument with escapes removed. In quotations, \" becomes
+         * a quote character, \\ becomes a backslash, and a backslash followed
+         * by anything else is dropped along with that character.
+         */
+        std::string toString() const;
+
+    private:
+        StringSlice text;
+        bool escapes = false;
+    };
+
+    /*
+     * What a line with no indentation turned out to be. A line may be both an
+     * assignment and a module header, like "name = value:", and it's up to the
+     * reader to decide which one it means.
+     */
+    struct Header {
+        HeaderType type = NO_HEADER;
+        StringSlice moduleName;
+        bool isAssignment = false;
+        StringSlice variableName;
+        Argument variableValue;
+    };
+
+    /* A command in a module's install, uninstall, or update actions. */
+    struct CommandLine {
+        StringSlice name;
+        std::vector<Argument> arguments;
+        /*
+         * Everything after the whitespace following the command name, used as
+         * the first line of a shell command. Only set if there was anything
+         * after the command name, even if it was only whitespace.
+         */
+        bool hasShellText = false;
+        StringSlice shellText;
+    };
+
+    enum CommandStatus { COMMAND_OK, NO_COMMAND, BAD_ARGUMENTS };
+
+    ConfigLexer(const StringSlice& line);
+
+    const StringSlice& getLine() const;
+    /* Returns the number of '\t' characters at the start of the line. */
+    int getIndents() const;
+    /* Equivalent to the line having length zero. */
+    bool isEmpty() const;
+    /*
+     * Tests if the line is a comment. A line is a comment if the first
+     * character in the line is COMMENT_DELIMITER, or if any of the next
+     * expectedIndents characters are COMMENT_DELIMITER and only tabs come
+     * before it. The reason for this is to embed the COMMENT_DELIMITER
+     * character in commands and in shell commands.
+     *
+     * Returns whether or not the line is a comment.
+     */
+    bool isComment(unsigned int expectedIndents) const;
+    /*
+     * Returns the line with up to indents tabs removed from the start of it.
+     */
+    StringSlice stripIndents(int indents) const;
+
+    /*
+     * Lexes the line as a line at the top level of the file. A module header
+     * is a line that starts with a non-white character and ends with a colon
+     * with optional whitespace around it, and the name is everything before
+     * that. If the name is exactly "install", "uninstall", or "update", then
+     * it starts those actions instead, and if it's "link" or "hardlink", then
+     * it starts files that are linked instead of copied.
+     *
+     * If lexAssignment is true, also checks if the line assigns a variable. A
+     * line assigns a variable if it begins with a token that contains no
+     * whitespace or colons, then whitespace, an equals sign, and exactly one
+     * argument. Warnings about malformed arguments are only given in that
+     * case.
+     */
+    void lexHeader(Header& header, bool lexAssignment) const;
+    /*
+     * Lexes the line as a command after stripping one indent. The command is
+     * the first token, which may not start with whitespace, and the remaining
+     * tokens are arguments.
+     *
+     * Returns NO_COMMAND if there's no command, BAD_ARGUMENTS if the arguments
+     * couldn't be extracted, and COMMAND_OK otherwise.
+     */
+    CommandStatus lexCommand(CommandLine& command) const;
+    /*
+     * Lexes the line as a list of arguments, such as a file line.
+     *
+     * Returns true on success, false on failure.
+     */
+    bool lexArguments(std::vector<Argument>& arguments) const;
+
+    /*
+     * Extracts the arguments from text, starting at start, according to the
+     * rules of quotations. A token may be surrounded by quotes on its own,
+     * which allow for whitespace inside. Quotes are allowed in the middle of
+     * tokens, but don't make anything literal. Quotes are not allowed as the
+     * last character of an unquoted token, and a quoted token must be
+     * followed by whitespace. To put a quote in a quoted token, escape it
+     * with \".
+     *
+     * Clears the given vector regardless of any errors encountered. Warnings
+     * are given with text as the line that failed.
+     *
+     * Returns true on success, false on failure.
+     */
+    static bool lexArguments(const StringSlice& text, size_t start,
+        std::vector<Argument>& arguments);
+
+private:
+    /*
+     * Splits arguments one character at a time so that it can be done in the
+     * same pass as something else. Warnings are held until finish() because
+     * the caller might decide that the text wasn't meant to be arguments at
+     * all.
+     */
+    class ArgumentScanner {
+    public:
+        ArgumentScanner(const char* data, std::vector<Argument>& arguments);
+        /* Processes the character at index in data. */
+        void feed(size_t index);
+        /*
+         * Ends the last token at end and gives any warnings, printing text as
+         * the line with the problem.
+         *
+         * Returns true if the arguments were well formed, false otherwise.
+         */
+        bool finish(size_t end, const StringSlice& text);
+
+    private:
+        enum Error {
+            NO_ERROR,
+            QUOTE_AT_END_ERROR,
+            MISSING_SPACE_ERROR,
+            UNCLOSED_QUOTE_ERROR
+        };
+
+        const char* data;
+        std::vector<Argument>& arguments;
+        Error error = NO_ERROR;
+        /* The number of empty quoted strings, which each get a warning. */
+        int emptyStringCount = 0;
+
+        bool inQuotes = false;
+        bool inWord = false;
+        bool lastCharEscape = false;
+        bool lastCharClosingQuote = false;
+        bool lastCharQuoteInNonQuoteWord = false;
+        size_t wordStart = 0;
+        bool wordHasEscapes = false;
+        /* How long the current quoted word is once escapes are removed. */
+        size_t wordLength = 0;
+    };
+
+    StringSlice line;
+    size_t indents = 0;
+};
+} /* namespace dfm */
+
+#endif /* CONFIG_LEXER_H */
@@ -31,6 +31,7 @@
 #include <iostream>
 
 #include "abstractwindow.h"
+#include "shellsession.h"
 
 namespace dfm {
 
@@ -111,8 +112,11 @@ DependencyAction::performAction()
         std::string userInput;
         std::getline(std::cin, userInput);
         if (userInput.length() != 0) {
-            int status = system(userInput.c_str());
-            if (status == -1) {
+            int status = 0;
+            if (!runShellCommand(userInput, status,
+                    [this](const char* data, size_t size, bool isError) {
+                        outputMessage(data, size, isError);
+                    })) {
                 warnx("Failed to create process to execute command %s.",
                     userInput.c_str());
                 return false;
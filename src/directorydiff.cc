@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "directorydiff.h"
+
+#include <sys/stat.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "util.h"
+
+namespace dfm {
+
+/* The threads that every comparison is using besides the calling ones. */
+static std::atomic<unsigned int> extraThreadsInUse(0);
+
+DirectoryDiff::DirectoryDiff(unsigned int threadCount)
+    : threadCount((threadCount > 0) ? threadCount : 1),
+      pendingTasks(0),
+      queuedTasks(0),
+      stopped(false)
+{
+}
+
+void
+DirectoryDiff::setStopAtFirstChange(bool stopAtFirstChange)
+{
+    this->stopAtFirstChange = stopAtFirstChange;
+}
+
+void
+DirectoryDiff::setIgnoreRemoved(bool ignoreRemoved)
+{
+    this->ignoreRemoved = ignoreRemoved;
+}
+
+bool
+DirectoryDiff::compare(const std::string& sourcePath,
+    const std::string& destinationPath, std::vector<Change>& changes)
+{
+    changes.clear();
+    sourceRoot =
+        open(sourcePath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (sourceRoot == -1)
+        return false;
+    destinationRoot =
+        open(destinationPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (destinationRoot == -1) {
+        close(sourceRoot);
+        changes.push_back(Change{ ADDED_CHANGE, "" });
+        return true;
+    }
+
+    workers.clear();
+    for (unsigned int i = 0; i < threadCount; i++)
+        workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    pendingTasks = 0;
+    queuedTasks = 0;
+    stopped = false;
+    addTask(0, "");
+    work(0);
+    /* Nothing can start a thread once every task is done. */
+    for (auto& thread : threads)
+        thread.join();
+    extraThreadsInUse -= threads.size();
+    threads.clear();
+    close(sourceRoot);
+    close(destinationRoot);
+
+    for (auto& worker : workers) {
+        changes.insert(
+            changes.end(), worker->changes.begin(), worker->changes.end());
+    }
+    workers.clear();
+    std::sort(changes.begin(), changes.end(),
+        [](const Change& first, const Change& second) {
+            if (first.path != second.path)
+                return first.path < second.path;
+            return first.type < second.type;
+        });
+    return true;
+}
+
+const char*
+DirectoryDiff::getChangeTypeName(ChangeType type)
+{
+    switch (type) {
+    case ADDED_CHANGE:
+        return "added";
+    case REMOVED_CHANGE:
+        return "removed";
+    case MODIFIED_CHANGE:
+        return "modified";
+    case MODE_CHANGED_CHANGE:
+        return "mode changed";
+    }
+    return "unknown";
+}
+
+void
+DirectoryDiff::work(unsigned int workerIndex)
+{
+    for (;;) {
+        Task task;
+        if (takeTask(workerIndex, task)) {
+            if (!stopped)
+                compareDirectories(workerIndex, task);
+            finishTask();
+            continue;
+        }
+        /* Someone else is still working and may queue more. */
+        std::unique_lock<std::mutex> lock(waitMutex);
+        taskChanged.wait(
+            lock, [this]() { return pendingTasks == 0 || queuedTasks > 0; });
+        if (pendingTasks == 0)
+            return;
+    }
+}
+
+void
+DirectoryDiff::startWorker()
+{
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    if (threads.size() + 1 >= threadCount)
+        return;
+    unsigned int inUse = extraThreadsInUse;
+    do {
+        if (inUse + 1 >= MAX_DIRECTORY_DIFF_THREADS)
+            return;
+    } while (!extraThreadsInUse.compare_exchange_weak(inUse, inUse + 1));
+    threads.push_back(
+        std::thread(&DirectoryDiff::work, this, threads.size() + 1));
+}
+
+void
+DirectoryDiff::finishTask()
+{
+    if (--pendingTasks == 0)
+        notifyWorkers(true);
+}
+
+void
+DirectoryDiff::notifyWorkers(bool all)
+{
+    /*
+     * Taking the lock makes sure that a worker that just found nothing to do
+     * is either waiting already or will see the change.
+     */
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+    }
+    if (all)
+        taskChanged.notify_all();
+    else
+        taskChanged.notify_one();
+}
+
+bool
+DirectoryDiff::takeTask(unsigned int workerIndex, Task& task)
+{
+    {
+        Worker& worker = *workers[workerIndex];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            queuedTasks--;
+            return true;
+        }
+    }
+    for (unsigned int i = 1; i < workers.size(); i++) {
+        Worker& victim = *workers[(workerIndex + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queuedTasks--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+DirectoryDiff::addTask(unsigned int workerIndex, const std::string& path)
+{
+    pendingTasks++;
+    size_t queued;
+    {
+        Worker& worker = *workers[workerIndex];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(Task{ path });
+        queued = ++queuedTasks;
+    }
+    /* One directory is left for this thread to do next. */
+    if (queued > 1)
+        startWorker();
+    notifyWorkers(false);
+}
+
+void
+DirectoryDiff::addChange(
+    unsigned int workerIndex, ChangeType type, const std::string& path)
+{
+    workers[workerIndex]->changes.push_back(Change{ type, path });
+    if (stopAtFirstChange)
+        stopped = true;
+}
+
+void
+DirectoryDiff::compareDirectories(unsigned int workerIndex, const Task& task)
+{
+    /* The roots are used directly for the top directory. */
+    const char* relativePath = (task.path.empty()) ? "." : task.path.c_str();
+    int source =
+        openat(sourceRoot, relativePath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (source == -1)
+        return;
+    int destination = openat(
+        destinationRoot, relativePath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (destination == -1) {
+        close(source);
+        addChange(workerIndex, MODIFIED_CHANGE, task.path);
+        return;
+    }
+    std::vector<std::string> sourceNames;
+    std::vector<std::string> destinationNames;
+    if (!readEntryNames(source, sourceNames)) {
+        close(source);
+        close(destination);
+        return;
+    }
+    if (!readEntryNames(destination, destinationNames)) {
+        close(source);
+        close(destination);
+        addChange(workerIndex, MODIFIED_CHANGE, task.path);
+        return;
+    }
+
+    std::string prefix = (task.path.empty()) ? "" : task.path + "/";
+    std::vector<std::string>::size_type sourceIndex = 0;
+    std::vector<std::string>::size_type destinationIndex = 0;
+    while ((sourceIndex < sourceNames.size()
+               || destinationIndex < destinationNames.size())
+        && !stopped) {
+        if (destinationIndex == destinationNames.size()
+            || (sourceIndex < sourceNames.size()
+                   && sourceNames[sourceIndex]
+                       < destinationNames[destinationIndex])) {
+            addChange(workerIndex, ADDED_CHANGE,
+                prefix + sourceNames[sourceIndex++]);
+            continue;
+        }
+        if (sourceIndex == sourceNames.size()
+            || destinationNames[destinationIndex] < sourceNames[sourceIndex]) {
+            if (!ignoreRemoved) {
+                addChange(workerIndex, REMOVED_CHANGE,
+                    prefix + destinationNames[destinationIndex]);
+            }
+            destinationIndex++;
+            continue;
+        }
+
+        const std::string& name = sourceNames[sourceIndex++];
+        destinationIndex++;
+        struct stat sourceInfo;
+        if (fstatat(source, name.c_str(), &sourceInfo, 0) != 0)
+            continue;
+        if (!S_ISREG(sourceInfo.st_mode) && !S_ISDIR(sourceInfo.st_mode))
+            continue;
+        struct stat destinationInfo;
+        if (fstatat(destination, name.c_str(), &destinationInfo, 0) != 0) {
+            addChange(workerIndex, ADDED_CHANGE, prefix + name);
+            continue;
+        }
+        if ((sourceInfo.st_mode & S_IFMT)
+            != (destinationInfo.st_mode & S_IFMT)) {
+            addChange(workerIndex, MODIFIED_CHANGE, prefix + name);
+            continue;
+        }
+        if (sourceInfo.st_mode != destinationInfo.st_mode)
+            addChange(workerIndex, MODE_CHANGED_CHANGE, prefix + name);
+        if (S_ISDIR(sourceInfo.st_mode))
+            addTask(workerIndex, prefix + name);
+        else if (sourceInfo.st_size != destinationInfo.st_size
+            || !haveSameContentsAt(source, destination, name))
+            addChange(workerIndex, MODIFIED_CHANGE, prefix + name);
+    }
+    close(source);
+    close(destination);
+}
+
+bool
+DirectoryDiff::readEntryNames(int descriptor, std::vector<std::string>& names)
+{
+    /* The directory takes ownership of the descriptor it's given. */
+    int directoryDescriptor = dup(descriptor);
+    if (directoryDescriptor == -1)
+        return false;
+    DIR* directory = fdopendir(directoryDescriptor);
+    if (directory == NULL) {
+        close(directoryDescriptor);
+        return false;
+    }
+    struct dirent* entry = readdir(directory);
+    while (entry != NULL) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..")
+            names.push_back(name);
+        entry = readdir(directory);
+    }
+    closedir(directory);
+    std::sort(names.begin(), names.end());
+    return true;
+}
+
+bool
+DirectoryDiff::haveSameContentsAt(
+    int source, int destination, const std::string& name)
+{
+    int sourceFile = openat(source, name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (sourceFile == -1)
+        return true;
+    int destinationFile =
+        openat(destination, name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (destinationFile == -1) {
+        close(sourceFile);
+        return false;
+    }
+    bool same = haveSameContents(sourceFile, destinationFile);
+    close(sourceFile);
+    close(destinationFile);
+    return same;
+}
+} /* namespace dfm */
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef DIRECTORY_DIFF_H
+#define DIRECTORY_DIFF_H
+
+#include "config.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dfm {
+
+/*
+ * The most threads to use when comparing two directories. The threads beyond
+ * the one calling compare() are shared by every comparison in the process, so
+ * comparisons done by the file threads of a module don't multiply them.
+ */
+const unsigned int MAX_DIRECTORY_DIFF_THREADS = 4;
+
+/*
+ * Finds everything that differs between a source directory and a destination
+ * directory that is supposed to be a copy of it.
+ *
+ * Both trees are walked at the same time by a group of threads. Each thread
+ * works on its own queue of directories and takes from the others when it runs
+ * out. Another thread is only started when there's more than one directory
+ * waiting, so small directories are compared by the calling thread alone.
+ * Entries are looked at relative to their open parent directories so that
+ * full paths only have to be built for subdirectories and changes.
+ *
+ * Symlinks are followed like everywhere else files are compared. Entries in
+ * both trees that aren't regular files or directories in the source are
+ * ignored.
+ */
+class DirectoryDiff {
+public:
+    enum ChangeType {
+        /* Only in the source, or the destination couldn't be read. */
+        ADDED_CHANGE,
+        /* Only in the destination. */
+        REMOVED_CHANGE,
+        /* In both, but with different contents or a different file type. */
+        MODIFIED_CHANGE,
+        /* In both, but with different permissions. */
+        MODE_CHANGED_CHANGE
+    };
+
+    struct Change {
+        ChangeType type;
+        /* Relative to the directories being compared, empty for themselves. */
+        std::string path;
+    };
+
+    DirectoryDiff(unsigned int threadCount = MAX_DIRECTORY_DIFF_THREADS);
+
+    /*
+     * Makes compare() stop at the first change it finds, for when only
+     * whether there are any changes matters.
+     */
+    void setStopAtFirstChange(bool stopAtFirstChange);
+    /*
+     * Makes compare() leave out entries that are only in the destination.
+     * They're included by default.
+     */
+    void setIgnoreRemoved(bool ignoreRemoved);
+
+    /*
+     * Compares the directory at sourcePath to the one at destinationPath and
+     * sets changes to every difference, sorted by path. Something that's
+     * added or removed is reported without anything inside of it. A file can
+     * be both modified and have its mode changed.
+     *
+     * Returns true on success, false if sourcePath couldn't be read as a
+     * directory.
+     */
+    bool compare(const std::string& sourcePath,
+        const std::string& destinationPath, std::vector<Change>& changes);
+
+    /* Returns a short name for type, like "added". */
+    static const char* getChangeTypeName(ChangeType type);
+
+private:
+    /* The directories at the same path in both trees. */
+    struct Task {
+        std::string path;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::vector<Change> changes;
+    };
+
+    unsigned int threadCount;
+    bool stopAtFirstChange = false;
+    bool ignoreRemoved = false;
+
+    /* Only valid during compare(). */
+    int sourceRoot = -1;
+    int destinationRoot = -1;
+    std::vector<std::unique_ptr<Worker>> workers;
+    /* The threads started besides the one calling compare(). */
+    std::mutex threadsMutex;
+    std::vector<std::thread> threads;
+    /* Tasks that have been queued but not finished. */
+    std::atomic<size_t> pendingTasks;
+    /* Tasks that are in a queue, changed while holding that queue's mutex. */
+    std::atomic<size_t> queuedTasks;
+    std::atomic<bool> stopped;
+    /* Idle workers wait on this for a task to be queued or for the end. */
+    std::mutex waitMutex;
+    std::condition_variable taskChanged;
+
+    /* Does tasks until there are none left anywhere. */
+    void work(unsigned int workerIndex);
+    /*
+     * Starts another worker thread if there are fewer than threadCount and
+     * the threads shared by every comparison aren't all in use.
+     */
+    void startWorker();
+    /* Marks a task as done, waking the idle workers if it was the last. */
+    void finishTask();
+    /* Wakes up the idle workers after the tasks have changed. */
+    void notifyWorkers(bool all);
+    /*
+     * Takes a task from the back of this worker's queue, or from the front of
+     * another worker's queue if it's empty.
+     *
+     * Returns true if a task was found, false otherwise.
+     */
+    bool takeTask(unsigned int workerIndex, Task& task);
+    void addTask(unsigned int workerIndex, const std::string& path);
+    void addChange(
+        unsigned int workerIndex, ChangeType type, const std::string& path);
+    /* Compares the entries in one pair of directories. */
+    void compareDirectories(unsigned int workerIndex, const Task& task);
+
+    /*
+     * Sets names to the names of the entries in the directory open at
+     * descriptor, sorted and without "." and "..".
+     *
+     * Returns true on success, false on failure.
+     */
+    static bool readEntryNames(int descriptor, std::vector<std::string>& names);
+    /*
+     * Returns whether the regular files called name in the directories open at
+     * source and destination have the same contents.
+     */
+    static bool haveSameContentsAt(
+        int source, int destination, const std::string& name);
+};
+} /* namespace dfm */
+
+#endif /* DIRECTORY_DIFF_H */
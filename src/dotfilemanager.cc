@@ -27,15 +27,24 @@
 #include <dirent.h>
 #include <err.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <fstream>
+#include <iostream>
 #include <sstream>
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "configfilereader.h"
+#include "modulecache.h"
+#include "modulegraph.h"
+#include "moduleindex.h"
+#include "modulescheduler.h"
+#include "shellsession.h"
 #include "util.h"
 
 namespace dfm {
@@ -51,15 +60,20 @@ DotFileManager::run()
         return EXIT_FAILURE;
     if (options->generateConfigFileFlag || options->dumpConfigFileFlag)
         return (createConfigFile()) ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (options->streamFlag) {
+        bool status = performStreamedOperation();
+        saveInstallState();
+        return (status) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
     if (!readModules())
         return EXIT_FAILURE;
     if (options->printModulesFlag) {
         printModules();
         return EXIT_SUCCESS;
     }
-    if (!performOperation())
-        return EXIT_FAILURE;
-    return EXIT_SUCCESS;
+    bool status = performOperation();
+    saveInstallState();
+    return (status) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 bool
@@ -74,6 +88,9 @@ DotFileManager::initializeOptions()
         return false;
     if (!options->verifyArguments())
         return false;
+    setSyncMode(options->syncMode);
+    setShellMode((options->freshShellFlag) ? FRESH_SHELL_MODE
+                                           : PERSISTENT_SHELL_MODE);
     /*
      * Change directories to the one specified by the options. This is so that
      * relative paths specified in the config file work.
@@ -84,56 +101,276 @@ DotFileManager::initializeOptions()
     return true;
 }
 
-bool
-DotFileManager::readModules()
+std::string
+DotFileManager::findConfigFile()
 {
-    std::string programDirectory;
-    programDirectory = (options->hasSourceDirectory) ? options->sourceDirectory
-                                                     : getCurrentDirectory();
     if (!options->hasSourceDirectory) {
         options->sourceDirectory = getCurrentDirectory();
         options->hasSourceDirectory = true;
     }
-    std::string configFilePath = programDirectory + "/" + CONFIG_FILE_NAME;
+    return options->sourceDirectory + "/" + CONFIG_FILE_NAME;
+}
 
-    ConfigFileReader reader(configFilePath);
+bool
+DotFileManager::readModules()
+{
+    ConfigFileReader reader(findConfigFile());
     reader.setOptions(options);
 
-    bool status = reader.readModules(std::back_inserter(modules));
+    /*
+     * When operating on modules by name, only those and what they require
+     * have to be parsed. The cache already has everything parsed.
+     */
+    bool readSelected = !options->allFlag && !options->useCacheFlag
+        && (options->installModulesFlag || options->uninstallModulesFlag
+               || options->updateModulesFlag);
+    bool status = (readSelected)
+        ? reader.readSelectedModules(
+              options->remainingArguments, std::back_inserter(modules))
+        : reader.readModules(std::back_inserter(modules));
     if (!status)
         warnx("Failed to read modules.");
     reader.close();
+    loadInstallState();
     for (auto& module : modules)
-        module.setWindow(&window);
+        setUpModule(module);
     return status;
 }
 
+void
+DotFileManager::loadInstallState()
+{
+    if (options->useStateFlag) {
+        installState = std::unique_ptr<InstallState>(new InstallState(
+            options->sourceDirectory + "/" + STATE_FILE_NAME));
+        installState->load();
+    }
+}
+
+void
+DotFileManager::setUpModule(Module& module)
+{
+    module.setWindow(&window);
+    module.setInstallState(installState.get());
+    module.setVerbose(options->verboseFlag);
+    module.setPruneExtraFiles(options->pruneFlag);
+}
+
 bool
-DotFileManager::performOperation()
+DotFileManager::performStreamedOperation()
 {
-    if (options->allFlag) {
-        for (const auto& module : modules) {
-            if (!operateOn(module))
+    ConfigFileReader reader(findConfigFile());
+    reader.setOptions(options);
+    loadInstallState();
+
+    /*
+     * A module is done as soon as it's read unless it requires one that
+     * hasn't been done yet, in which case it waits until that one is.
+     */
+    std::unordered_set<std::string> doneNames;
+    std::vector<Module> waitingModules;
+    auto isReady = [&doneNames](const Module& module) {
+        for (const auto& requirement : module.getRequirements()) {
+            if (doneNames.count(requirement) == 0)
                 return false;
         }
         return true;
+    };
+    ModuleStream stream(reader);
+    Module module;
+    while (stream.next(module)) {
+        setUpModule(module);
+        if (!isReady(module)) {
+            waitingModules.push_back(std::move(module));
+            continue;
+        }
+        if (!operateOn(module))
+            return false;
+        doneNames.insert(module.getName());
+        /* Doing one module can let waiting ones go, which can let more go. */
+        bool didModule = true;
+        while (didModule) {
+            didModule = false;
+            for (auto i = waitingModules.begin(); i != waitingModules.end();
+                 i++) {
+                if (!isReady(*i))
+                    continue;
+                if (!operateOn(*i))
+                    return false;
+                doneNames.insert(i->getName());
+                waitingModules.erase(i);
+                didModule = true;
+                break;
+            }
+        }
+    }
+    if (stream.hasError()) {
+        warnx("Failed to read modules.");
+        return false;
+    }
+    if (!waitingModules.empty()) {
+        reportUnmetRequirements(waitingModules, stream, doneNames);
+        return false;
+    }
+    return true;
+}
+
+void
+DotFileManager::reportUnmetRequirements(const std::vector<Module>& waiting,
+    const ModuleStream& stream,
+    const std::unordered_set<std::string>& doneNames) const
+{
+    bool foundUnknown = false;
+    for (const auto& module : waiting) {
+        for (const auto& requirement : module.getRequirements()) {
+            if (!stream.hasReadModule(requirement)) {
+                warnx("Module \"%s\" requires unknown module \"%s\".",
+                    module.getName().c_str(), requirement.c_str());
+                foundUnknown = true;
+            }
+        }
+    }
+    if (foundUnknown)
+        return;
+    /*
+     * Every module that's still waiting requires another one that's waiting,
+     * so following those from any of them has to come back around.
+     */
+    ModuleIndex index(waiting);
+    std::vector<int> path;
+    std::vector<int> pathPositions(waiting.size(), -1);
+    int current = 0;
+    while (pathPositions[current] == -1) {
+        pathPositions[current] = path.size();
+        path.push_back(current);
+        for (const auto& requirement : waiting[current].getRequirements()) {
+            if (doneNames.count(requirement) == 0) {
+                current = index.findModule(requirement);
+                break;
+            }
+        }
+    }
+    std::string cycle;
+    for (auto i = path.begin() + pathPositions[current]; i != path.end(); i++)
+        cycle += "\"" + waiting[*i].getName() + "\" -> ";
+    cycle += "\"" + waiting[current].getName() + "\"";
+    warnx("Modules require each other: %s.", cycle.c_str());
+}
+
+bool
+DotFileManager::performOperation()
+{
+    ModuleIndex index(modules);
+    ModuleGraph graph(modules, index);
+    if (!graph.build())
+        return false;
+    /*
+     * Find every module before starting so that an unknown name doesn't
+     * leave some modules done.
+     */
+    std::vector<int> selected;
+    if (options->allFlag) {
+        for (std::vector<Module>::size_type i = 0; i < modules.size(); i++)
+            selected.push_back(i);
     }
     for (const auto& moduleName : options->remainingArguments) {
-        auto nameMatches = [&moduleName](
-            const Module& module) { return moduleName == module.getName(); };
-        std::vector<Module>::iterator modulePosition =
-            std::find_if(modules.begin(), modules.end(), nameMatches);
-        if (modulePosition != modules.end()) {
-            if (!operateOn(*modulePosition))
-                return false;
-        } else {
+        /* A module can have wildcard characters in its name. */
+        int moduleIndex = index.findModule(moduleName);
+        if (moduleIndex != -1) {
+            selected.push_back(moduleIndex);
+            continue;
+        }
+        if (!ModuleIndex::isPattern(moduleName)) {
             warnx("Unknown module \"%s\".", moduleName.c_str());
             return false;
         }
+        std::vector<int> matches = index.findMatchingModules(moduleName);
+        if (matches.empty()) {
+            warnx("No modules match \"%s\".", moduleName.c_str());
+            return false;
+        }
+        selected.insert(selected.end(), matches.begin(), matches.end());
+    }
+
+    /*
+     * Uninstalling a module leaves the ones it requires alone, since other
+     * modules could still need them, but goes in the opposite order.
+     */
+    bool reversed = options->uninstallModulesFlag;
+    std::vector<int> order = (reversed)
+        ? graph.sortModules(selected)
+        : graph.sortModules(graph.addRequirements(selected));
+    if (reversed)
+        std::reverse(order.begin(), order.end());
+    std::vector<std::vector<int>> prerequisites =
+        graph.findPrerequisites(order, reversed);
+    if (options->verboseFlag && !order.empty()) {
+        std::vector<int> criticalPath =
+            ModuleGraph::findCriticalPath(prerequisites);
+        std::string pathNames;
+        for (int position : criticalPath) {
+            if (!pathNames.empty())
+                pathNames += " -> ";
+            pathNames += modules[order[position]].getName();
+        }
+        std::cout << "Critical path: " << pathNames << " ("
+                  << criticalPath.size() << " of " << order.size()
+                  << " modules)." << std::endl;
+    }
+
+    if (options->jobCount > 1)
+        return performParallelOperation(order, prerequisites);
+    for (int index : order) {
+        if (!operateOn(modules[index]))
+            return false;
     }
     return true;
 }
 
+bool
+DotFileManager::performParallelOperation(const std::vector<int>& order,
+    const std::vector<std::vector<int>>& prerequisites)
+{
+    ModuleScheduler scheduler(options->jobCount);
+    std::vector<std::vector<std::string>> destinationPaths;
+    for (std::vector<int>::size_type i = 0; i < order.size(); i++) {
+        const Module& module = modules[order[i]];
+        scheduler.addModule(module);
+        for (int prerequisite : prerequisites[i])
+            scheduler.addPrerequisite(i, prerequisite);
+        destinationPaths.push_back(getDestinationPaths(module));
+    }
+    scheduler.addPathConflicts(destinationPaths);
+    /* Each module runs in its own process, so each one saves its own state. */
+    return scheduler.run([this](const Module& module) {
+        bool status = operateOn(module);
+        saveInstallState();
+        return status;
+    });
+}
+
+std::vector<std::string>
+DotFileManager::getDestinationPaths(const Module& module) const
+{
+    std::vector<std::string> paths;
+    for (const auto& file : module.getFiles())
+        paths.push_back(file.getDestinationPath());
+    const std::vector<std::shared_ptr<ModuleAction>>* actions = nullptr;
+    if (options->installModulesFlag)
+        actions = &module.getInstallActions();
+    else if (options->uninstallModulesFlag)
+        actions = &module.getUninstallActions();
+    else if (options->updateModulesFlag)
+        actions = &module.getUpdateActions();
+    if (actions == nullptr)
+        return paths;
+    for (const auto& action : *actions) {
+        for (const auto& path : action->getDestinationPaths())
+            paths.push_back(shellExpandPath(path));
+    }
+    return paths;
+}
+
 bool
 DotFileManager::operateOn(const Module& module)
 {
@@ -165,6 +402,14 @@ DotFileManager::operateOn(const Module& module)
     return status;
 }
 
+void
+DotFileManager::saveInstallState()
+{
+    if (installState && !installState->save())
+        warnx("Failed to save install state to %s.",
+            installState->getPath().c_str());
+}
+
 bool
 DotFileManager::createConfigFile() const
 {
@@ -211,9 +456,13 @@ DotFileManager::writeConfigFile(
         /*
          * This is to prevent adding config.dfm to the list. This could happen
          * if config.dfm is already there or if outputStream points to a new
-         * file called config.dfm and it iscreated because of it.
+         * file called config.dfm and it iscreated because of it. The cache
+         * and the install state with its lock file aren't something to install
+         * either.
          */
-        if (entryName == CONFIG_FILE_NAME)
+        if (entryName == CONFIG_FILE_NAME || entryName == CACHE_FILE_NAME
+            || entryName.compare(0, strlen(STATE_FILE_NAME), STATE_FILE_NAME)
+                == 0)
             continue;
         outputStream << "\t" << entryName << std::endl;
     }
@@ -26,9 +26,14 @@
 #include "config.h"
 
 #include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "module.h"
+#include "modulestream.h"
 #include "options.h"
+#include "installstate.h"
 #include "terminalwindow.h"
 
 namespace dfm {
@@ -44,11 +49,64 @@ private:
 
     std::shared_ptr<DfmOptions> options;
     std::vector<Module> modules;
+    /* Null unless installed files are being recorded. */
+    std::unique_ptr<InstallState> installState;
 
     bool initializeOptions();
+    /*
+     * Makes the source directory the current one if none was given.
+     *
+     * Returns the path of the config file in the source directory.
+     */
+    std::string findConfigFile();
     bool readModules();
+    /* Loads the install state if installed files are being recorded. */
+    void loadInstallState();
+    /* Gives the module the window, install state, and flags to use. */
+    void setUpModule(Module& module);
+    /*
+     * Performs the operation on the selected modules and, unless uninstalling,
+     * the modules they require, so that no module is done before the ones it
+     * requires or, when uninstalling, after them.
+     *
+     * Returns true if every module succeeded, false otherwise.
+     */
     bool performOperation();
+    /*
+     * Performs the operation on the modules at the indices in order with up
+     * to the number of jobs in the options running at once. Each module waits
+     * for the positions in order given by prerequisites. Modules that write
+     * to the same files are still done one at a time and in order.
+     *
+     * Returns true if every module succeeded, false otherwise.
+     */
+    bool performParallelOperation(const std::vector<int>& order,
+        const std::vector<std::vector<int>>& prerequisites);
+    /*
+     * Performs the operation on every module while the config file is still
+     * being read, doing each one as soon as it and the modules it requires
+     * have been read. Modules read before an error in the config file have
+     * already been done.
+     *
+     * Returns true if every module was read and succeeded, false otherwise.
+     */
+    bool performStreamedOperation();
+    /*
+     * Warns about why the waiting modules could never be done, which is
+     * either a requirement that was never read or modules that require each
+     * other.
+     */
+    void reportUnmetRequirements(const std::vector<Module>& waiting,
+        const ModuleStream& stream,
+        const std::unordered_set<std::string>& doneNames) const;
     bool operateOn(const Module& module);
+    /* Saves the install state if there is one, and warns on failure. */
+    void saveInstallState();
+    /*
+     * Returns the shell expanded paths that the current operation writes to or
+     * removes for the given module.
+     */
+    std::vector<std::string> getDestinationPaths(const Module& module) const;
 
     /*
      * Determines the correct stream to write to based on the flags in options
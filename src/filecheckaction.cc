@@ -28,14 +28,17 @@
 
 #include <assert.h>
 #include <err.h>
+#include <fcntl.h>
 #include <libgen.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-#include <fstream>
+#include <iostream>
 
 #include "abstractwindow.h"
 #include "installaction.h"
+#include "installstate.h"
 #include "util.h"
 
 namespace dfm {
@@ -86,72 +89,116 @@ FileCheckAction::setFiles(
 }
 
 bool
-FileCheckAction::shouldUpdateRegularFile(
-    const std::string& sourcePath, const std::string& destinationPath) const
+FileCheckAction::shouldUpdateRegularFile(const std::string& sourcePath,
+    const std::string& destinationPath, const uint64_t* knownHash) const
 {
     if (sourcePath == destinationPath)
         return false;
     if (sourcePath.length() == 0 || destinationPath.length() == 0)
         return false;
 
-    std::ifstream sourceReader(sourcePath.c_str());
-    if (!sourceReader.is_open()) {
-        return false;
-    }
     /*
-     * This section returns true on failure because it means that it could open
-     * the file it is supposed to be a copy of but not the copied file, meaning
-     * it needs to be updated.
+     * Like below, a source that can't be read is left alone but a destination
+     * that can't be read needs to be updated.
      */
-    std::ifstream destinationReader(destinationPath.c_str());
-    if (!destinationReader.is_open()) {
-        sourceReader.close();
+    struct stat sourceInfo;
+    if (stat(sourcePath.c_str(), &sourceInfo) != 0)
+        return false;
+    struct stat destinationInfo;
+    if (stat(destinationPath.c_str(), &destinationInfo) != 0)
         return true;
-    }
-    std::string sourceLine;
-    std::string destinationLine;
-    bool sourceReadStatus = false;
-    bool destinationReadStatus = false;
-
-    sourceReadStatus = (std::getline(sourceReader, sourceLine)) ? true : false;
-    destinationReadStatus =
-        (std::getline(destinationReader, destinationLine)) ? true : false;
-
-    if (sourceReadStatus != destinationReadStatus) {
-        sourceReader.close();
-        destinationReader.close();
+    if (sourceInfo.st_size != destinationInfo.st_size)
         return true;
+    if (knownHash != nullptr) {
+        uint64_t sourceHash = 0;
+        return !hashFile(sourcePath, sourceHash) || sourceHash != *knownHash;
     }
-    while (sourceReadStatus && destinationReadStatus) {
-        if (sourceLine != destinationLine) {
-            sourceReader.close();
-            destinationReader.close();
-            return true;
-        }
-        sourceReadStatus =
-            (std::getline(sourceReader, sourceLine)) ? true : false;
-        destinationReadStatus =
-            (std::getline(destinationReader, destinationLine)) ? true : false;
-        if (sourceReadStatus != destinationReadStatus) {
-            sourceReader.close();
-            destinationReader.close();
-            return true;
-        }
+
+    int source = open(sourcePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source == -1)
+        return false;
+    int destination = open(destinationPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (destination == -1) {
+        close(source);
+        return true;
     }
-    sourceReader.close();
-    destinationReader.close();
-    return false;
+    bool differs = !haveSameContents(source, destination);
+    close(source);
+    close(destination);
+    return differs;
+}
+
+InstallMode
+FileCheckAction::getInstallMode() const
+{
+    return installMode;
+}
+
+void
+FileCheckAction::setInstallMode(InstallMode installMode)
+{
+    this->installMode = installMode;
+}
+
+bool
+FileCheckAction::prunesExtraFiles() const
+{
+    return pruneExtraFiles;
+}
+
+void
+FileCheckAction::setPruneExtraFiles(bool pruneExtraFiles)
+{
+    this->pruneExtraFiles = pruneExtraFiles;
 }
 
 bool
 FileCheckAction::shouldUpdate() const
 {
     if (!hasFiles()) {
-        warnx("Missing file to check for updates.");
+        warningMessage("Missing file to check for updates.");
         return false;
     }
-    return shouldUpdateFile(
-        shellExpandPath(sourcePath), shellExpandPath(destinationPath));
+    std::string expandedSourcePath = shellExpandPath(sourcePath);
+    std::string expandedDestinationPath = shellExpandPath(destinationPath);
+    /* Links never have to be read, they just have to point to the source. */
+    if (installMode != COPY_INSTALL_MODE) {
+        return !isLinkTo(getAbsolutePath(expandedSourcePath),
+            expandedDestinationPath, installMode);
+    }
+    InstallState* installState = getInstallState();
+    if (installState == nullptr) {
+        return shouldUpdateFile(expandedSourcePath, expandedDestinationPath,
+            (hasDestinationHash) ? &destinationHash : nullptr);
+    }
+
+    /* Neither file has to be opened if they haven't changed. */
+    if (installState->isUnchanged(expandedSourcePath, expandedDestinationPath))
+        return false;
+    uint64_t knownHash = destinationHash;
+    bool hasKnownHash = hasDestinationHash
+        || installState->getDestinationHash(
+               expandedDestinationPath, knownHash);
+    bool update = shouldUpdateFile(expandedSourcePath,
+        expandedDestinationPath, (hasKnownHash) ? &knownHash : nullptr);
+    /* Remember that they're the same so the next check is quick. */
+    if (!update)
+        installState->recordInstall(
+            expandedSourcePath, expandedDestinationPath);
+    return update;
+}
+
+void
+FileCheckAction::setDestinationHash(uint64_t hash)
+{
+    destinationHash = hash;
+    hasDestinationHash = true;
+}
+
+void
+FileCheckAction::clearDestinationHash()
+{
+    hasDestinationHash = false;
 }
 
 bool
@@ -163,57 +210,23 @@ FileCheckAction::shouldUpdateDirectory(
     if (sourcePath.size() == 0 || destinationPath.size() == 0)
         return false;
 
-    struct dirent** sourceEntries = nullptr;
-    struct dirent** destinationEntries = nullptr;
-
-    int sourceCount =
-        scandir(sourcePath.c_str(), &sourceEntries, returnOne, alphasort);
-    if (sourceCount == -1) {
-        return false;
-    }
-    int destinationCount = scandir(
-        destinationPath.c_str(), &destinationEntries, returnOne, alphasort);
+    DirectoryDiff diff;
+    diff.setStopAtFirstChange(true);
+    diff.setIgnoreRemoved(!pruneExtraFiles);
+    std::vector<DirectoryDiff::Change> changes;
     /*
-     * The logic here is the same as in the regular file function. If it can't
-     * open the destination direcvory, there must be a problem and should
-     * thusly be updated.
+     * The logic here is the same as in the regular file function. A source
+     * that can't be read is left alone, and a destination that can't be read
+     * is reported as a change.
      */
-    if (destinationCount == -1) {
-        return true;
-    }
-    if (sourceCount != destinationCount) {
-        return true;
-    }
-    /*
-     * Both lists were sorted using the same algorithm, alphasort, which means
-     * that if they contain the same entries they should be in the same order.
-     */
-    for (int i = 0; i < sourceCount; i++) {
-        struct dirent* sourceEntry = sourceEntries[i];
-        struct dirent* destinationEntry = destinationEntries[i];
-        /*
-         * I dont' think I have to check destinationEntry here because they
-         * should both start with "." and ".." anyways.
-         */
-        if (strcmp(sourceEntry->d_name, ".") == 0
-            || strcmp(sourceEntry->d_name, "..") == 0
-            || strcmp(destinationEntry->d_name, ".") == 0
-            || strcmp(destinationEntry->d_name, "..") == 0)
-            continue;
-        if (strcmp(sourceEntry->d_name, destinationEntry->d_name) != 0)
-            return true;
-        std::string sourceEntryPath = sourcePath + "/" + sourceEntry->d_name;
-        std::string destinationEntryPath =
-            destinationPath + "/" + destinationEntry->d_name;
-        if (shouldUpdateFile(sourceEntryPath, destinationEntryPath))
-            return true;
-    }
-    return false;
+    if (!diff.compare(sourcePath, destinationPath, changes))
+        return false;
+    return !changes.empty();
 }
 
 bool
-FileCheckAction::shouldUpdateFile(
-    const std::string& sourcePath, const std::string& destinationPath) const
+FileCheckAction::shouldUpdateFile(const std::string& sourcePath,
+    const std::string& destinationPath, const uint64_t* knownHash) const
 {
     struct stat sourceInfo;
     if (stat(sourcePath.c_str(), &sourceInfo) != 0) {
@@ -231,7 +244,8 @@ FileCheckAction::shouldUpdateFile(
         return true;
 
     if (S_ISREG(sourceInfo.st_mode))
-        return shouldUpdateRegularFile(sourcePath, destinationPath);
+        return shouldUpdateRegularFile(
+            sourcePath, destinationPath, knownHash);
     /*
      * It was already checked about that the source mode is either a regular
      * file or a directory, so if it's not a regular file then it must be a
@@ -249,6 +263,37 @@ FileCheckAction::hasFiles() const
 bool
 FileCheckAction::performAction()
 {
+    std::string expandedSourcePath = shellExpandPath(this->sourcePath);
+    std::string expandedDestinationPath =
+        shellExpandPath(this->destinationPath);
+    /* Directories that are already installed only get what changed. */
+    if (installMode == COPY_INSTALL_MODE
+        && expandedSourcePath != expandedDestinationPath
+        && isDirectory(expandedSourcePath)
+        && isDirectory(expandedDestinationPath)) {
+        DirectoryDiff diff;
+        diff.setIgnoreRemoved(!pruneExtraFiles);
+        std::vector<DirectoryDiff::Change> changes;
+        if (!diff.compare(expandedSourcePath, expandedDestinationPath, changes)
+            || changes.empty())
+            return true;
+        if (isInteractive()) {
+            std::string prompt = "Update " + expandedDestinationPath
+                + " from " + expandedSourcePath + "?";
+            if (!getYesOrNo(prompt))
+                return true;
+            std::cout << std::endl;
+        }
+        uint64_t bytesWritten = 0;
+        size_t changeCount = 0;
+        bool updated = applyChanges(expandedSourcePath,
+            expandedDestinationPath, changes, bytesWritten, changeCount);
+        verboseMessage("Updated %s with %zu changes, %llu bytes written.\n\n",
+            expandedDestinationPath.c_str(), changeCount,
+            (unsigned long long) bytesWritten);
+        return updated;
+    }
+
     if (!shouldUpdate())
         return true;
     /*
@@ -289,9 +334,125 @@ FileCheckAction::performAction()
         destinationDirectory);
     action.setVerbose(isVerbose());
     action.setInteractive(isInteractive());
+    action.setInstallState(getInstallState());
+    action.setInstallMode(installMode);
     return action.performAction();
 }
 
+/* Returns name in the directory at path, or path itself if name is empty. */
+static std::string
+getEntryPath(const std::string& path, const std::string& name)
+{
+    return (name.empty()) ? path : path + "/" + name;
+}
+
+bool
+FileCheckAction::updateDirectory(const std::string& sourcePath,
+    const std::string& destinationPath, uint64_t& bytesWritten,
+    size_t& changeCount)
+{
+    DirectoryDiff diff;
+    diff.setIgnoreRemoved(!pruneExtraFiles);
+    std::vector<DirectoryDiff::Change> changes;
+    if (!diff.compare(sourcePath, destinationPath, changes)) {
+        warningMessage("Failed to read directory %s.", sourcePath.c_str());
+        return false;
+    }
+    return applyChanges(
+        sourcePath, destinationPath, changes, bytesWritten, changeCount);
+}
+
+bool
+FileCheckAction::applyChanges(const std::string& sourcePath,
+    const std::string& destinationPath,
+    const std::vector<DirectoryDiff::Change>& changes, uint64_t& bytesWritten,
+    size_t& changeCount)
+{
+    bool updated = true;
+    for (const auto& change : changes) {
+        if (change.type != DirectoryDiff::MODE_CHANGED_CHANGE
+            && !applyChange(sourcePath, destinationPath, change, bytesWritten,
+                   changeCount))
+            updated = false;
+    }
+    /*
+     * Permissions are changed last, deepest first, so that a directory that's
+     * becoming read only can still have its contents updated.
+     */
+    for (auto change = changes.rbegin(); change != changes.rend(); change++) {
+        if (change->type == DirectoryDiff::MODE_CHANGED_CHANGE
+            && !applyChange(sourcePath, destinationPath, *change,
+                   bytesWritten, changeCount))
+            updated = false;
+    }
+    return updated;
+}
+
+bool
+FileCheckAction::applyChange(const std::string& sourcePath,
+    const std::string& destinationPath, const DirectoryDiff::Change& change,
+    uint64_t& bytesWritten, size_t& changeCount)
+{
+    std::string sourceEntryPath = getEntryPath(sourcePath, change.path);
+    std::string destinationEntryPath =
+        getEntryPath(destinationPath, change.path);
+    changeCount++;
+    if (change.type == DirectoryDiff::REMOVED_CHANGE) {
+        verboseMessage("Removing %s.\n", destinationEntryPath.c_str());
+        if (removeTree(destinationEntryPath))
+            return true;
+        warningMessage("Failed to remove %s.", destinationEntryPath.c_str());
+        return false;
+    }
+
+    struct stat sourceInfo;
+    if (stat(sourceEntryPath.c_str(), &sourceInfo) != 0)
+        return true;
+    mode_t permissions = sourceInfo.st_mode & 07777;
+    if (change.type == DirectoryDiff::MODE_CHANGED_CHANGE) {
+        if (chmod(destinationEntryPath.c_str(), permissions) == 0)
+            return true;
+        warningMessage("Failed to change the permissions of %s.",
+            destinationEntryPath.c_str());
+        return false;
+    }
+
+    struct stat destinationInfo;
+    bool destinationExists =
+        stat(destinationEntryPath.c_str(), &destinationInfo) == 0;
+    if (destinationExists
+        && (sourceInfo.st_mode & S_IFMT) != (destinationInfo.st_mode & S_IFMT)
+        && !removeTree(destinationEntryPath)) {
+        warningMessage("Failed to remove %s.", destinationEntryPath.c_str());
+        return false;
+    }
+    if (S_ISDIR(sourceInfo.st_mode)) {
+        /*
+         * New directories are filled in the same way as existing ones so that
+         * everything in them ends up with the right permissions. They're made
+         * read only at the end in case they're supposed to be.
+         */
+        if (!ensureDirectoriesExist(destinationEntryPath)) {
+            warningMessage(
+                "Failed to create directory %s.", destinationEntryPath.c_str());
+            return false;
+        }
+        bool updated = updateDirectory(sourceEntryPath, destinationEntryPath,
+            bytesWritten, changeCount);
+        return chmod(destinationEntryPath.c_str(), permissions) == 0 && updated;
+    }
+    verboseMessage("Copying %s to %s.\n", sourceEntryPath.c_str(),
+        destinationEntryPath.c_str());
+    if (!copyFile(sourceEntryPath, destinationEntryPath)
+        || chmod(destinationEntryPath.c_str(), permissions) != 0) {
+        warningMessage("Failed to copy %s to %s.", sourceEntryPath.c_str(),
+            destinationEntryPath.c_str());
+        return false;
+    }
+    bytesWritten += sourceInfo.st_size;
+    return true;
+}
+
 void
 FileCheckAction::updateName()
 {
@@ -309,6 +470,14 @@ FileCheckAction::createConfigLines() const
     return lines;
 }
 
+std::vector<std::string>
+FileCheckAction::getDestinationPaths() const
+{
+    std::vector<std::string> paths;
+    paths.push_back(destinationPath);
+    return paths;
+}
+
 void
 FileCheckAction::graphicalEdit()
 {
@@ -25,13 +25,15 @@
 
 #include "config.h"
 
-#include <dirent.h>
+#include <stdint.h>
 
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "directorydiff.h"
 #include "moduleaction.h"
+#include "util.h"
 
 namespace dfm {
 
@@ -52,24 +54,82 @@ public:
     bool performAction() override;
 
     bool shouldUpdate() const;
+    /*
+     * Whether updating a directory leaves files in the destination that
+     * aren't in the source instead of removing them. Off by default.
+     */
+    InstallMode getInstallMode() const;
+    /*
+     * Sets whether the destination is a copy of the source or a link to it.
+     * A link only needs to be updated if it doesn't point at the source.
+     */
+    void setInstallMode(InstallMode installMode);
+    bool prunesExtraFiles() const;
+    void setPruneExtraFiles(bool pruneExtraFiles);
+    /*
+     * Sets the hash from hashFile() of the destination file, like from when it
+     * was last installed. Checking a regular file for updates then only reads
+     * the source file. This must only be set when the destination is known
+     * not to have changed since it was hashed.
+     */
+    void setDestinationHash(uint64_t hash);
+    void clearDestinationHash();
 
     void updateName() override;
     std::vector<std::string> createConfigLines() const override;
+    std::vector<std::string> getDestinationPaths() const override;
     void graphicalEdit() override;
 
 private:
     /* Returns if neither path is a zero-length string. */
     bool hasFiles() const;
 
+    /*
+     * If knownHash isn't null, then it's the hash of the file at
+     * destinationPath.
+     */
     bool shouldUpdateFile(const std::string& sourcePath,
-        const std::string& destinationPath) const;
+        const std::string& destinationPath,
+        const uint64_t* knownHash = nullptr) const;
     bool shouldUpdateRegularFile(const std::string& sourcePath,
-        const std::string& destinationPath) const;
+        const std::string& destinationPath,
+        const uint64_t* knownHash) const;
     bool shouldUpdateDirectory(const std::string& sourcePath,
         const std::string& destinationPath) const;
 
+    /*
+     * Changes the directory at destinationPath to match the one at sourcePath
+     * by only copying, removing, and changing the permissions of what's
+     * different. Adds the number of bytes copied to bytesWritten and the number
+     * of differences to changeCount.
+     *
+     * Returns true on success, false on failure.
+     */
+    bool updateDirectory(const std::string& sourcePath,
+        const std::string& destinationPath, uint64_t& bytesWritten,
+        size_t& changeCount);
+    /* Applies every one of changes like updateDirectory() does. */
+    bool applyChanges(const std::string& sourcePath,
+        const std::string& destinationPath,
+        const std::vector<DirectoryDiff::Change>& changes,
+        uint64_t& bytesWritten, size_t& changeCount);
+    /*
+     * Makes the entry in destinationPath match the one in sourcePath for
+     * change.
+     *
+     * Returns true on success, false on failure.
+     */
+    bool applyChange(const std::string& sourcePath,
+        const std::string& destinationPath,
+        const DirectoryDiff::Change& change, uint64_t& bytesWritten,
+        size_t& changeCount);
+
     std::string sourcePath;
     std::string destinationPath;
+    bool hasDestinationHash = false;
+    uint64_t destinationHash = 0;
+    bool pruneExtraFiles = false;
+    InstallMode installMode = COPY_INSTALL_MODE;
 };
 } /* namespace 2016 */
 
@@ -33,6 +33,7 @@
 
 #include <algorithm>
 #include <iostream>
+#include <utility>
 
 #include "configfilereader.h"
 #include "configfilewriter.h"
@@ -207,7 +208,7 @@ GdfmWindow::loadFile(const std::string& path)
     for (auto& module : modules)
         module.setWindow(this);
     currentFilePath = path;
-    setModulesViewFromModules(modules);
+    setModulesViewFromModules(std::move(modules));
     return true;
 }
 
@@ -228,23 +229,23 @@ GdfmWindow::loadDirectory(const std::string& path)
 }
 
 void
-GdfmWindow::setModulesViewFromModules(const std::vector<Module>& modules)
+GdfmWindow::setModulesViewFromModules(std::vector<Module> modules)
 {
-    for (const auto& module : modules) {
-        appendModule(module);
+    for (auto& module : modules) {
+        appendModule(std::make_shared<Module>(std::move(module)));
     }
 }
 
 void
-GdfmWindow::appendModule(const Module& module)
+GdfmWindow::appendModule(std::shared_ptr<Module> module)
 {
     Gtk::TreeModel::iterator topIter = modulesStore->append();
     Gtk::TreeModel::Row topRow = *topIter;
-    topRow[moduleNameColumn] = module.getName();
-    topRow[moduleColumn] = std::shared_ptr<Module>(new Module(module));
+    topRow[moduleNameColumn] = module->getName();
+    topRow[moduleColumn] = module;
     topRow[rowTypeColumn] = MODULE_ROW;
 
-    for (const auto& file : module.getFiles()) {
+    for (const auto& file : module->getFiles()) {
         Gtk::TreeIter fileIter = modulesStore->append(topRow.children());
         Gtk::TreeRow fileRow = *fileIter;
         fileRow[fileColumn] = file.getFilename();
@@ -253,8 +254,8 @@ GdfmWindow::appendModule(const Module& module)
         fileRow[rowTypeColumn] = MODULE_FILE_ROW;
     }
 
-    const std::vector<std::shared_ptr<ModuleAction>> installActions =
-        module.getInstallActions();
+    const std::vector<std::shared_ptr<ModuleAction>>& installActions =
+        module->getInstallActions();
     if (installActions.size() > 0) {
         Gtk::TreeModel::iterator typeIter =
             modulesStore->append(topRow.children());
@@ -270,8 +271,8 @@ GdfmWindow::appendModule(const Module& module)
             actionRow[rowTypeColumn] = MODULE_ACTION_ROW;
         }
     }
-    const std::vector<std::shared_ptr<ModuleAction>> uninstallActions =
-        module.getUninstallActions();
+    const std::vector<std::shared_ptr<ModuleAction>>& uninstallActions =
+        module->getUninstallActions();
     if (uninstallActions.size() > 0) {
         Gtk::TreeModel::iterator typeIter =
             modulesStore->append(topRow.children());
@@ -287,8 +288,8 @@ GdfmWindow::appendModule(const Module& module)
             actionRow[rowTypeColumn] = MODULE_ACTION_ROW;
         }
     }
-    const std::vector<std::shared_ptr<ModuleAction>> updateActions =
-        module.getUpdateActions();
+    const std::vector<std::shared_ptr<ModuleAction>>& updateActions =
+        module->getUpdateActions();
     if (updateActions.size() > 0) {
         Gtk::TreeModel::iterator typeIter =
             modulesStore->append(topRow.children());
@@ -314,7 +315,7 @@ GdfmWindow::onAddModuleButtonClicked()
     if (response == Gtk::RESPONSE_OK) {
         std::shared_ptr<Module> module = dialog.getModule();
         if (module)
-            appendModule(*module);
+            appendModule(module);
     }
 }
 
@@ -373,7 +374,7 @@ GdfmWindow::onActionSave()
         else
             return;
     }
-    ConfigFileWriter writer(outputFile, modules);
+    ConfigFileWriter writer(outputFile, std::move(modules));
     if (!writer.isOpen()) {
         Gtk::MessageDialog dialog(*this,
             "Failed to open file " + outputFile + ".", false,
@@ -404,7 +405,7 @@ GdfmWindow::onActionSaveAs()
     if (response != Gtk::RESPONSE_OK)
         return;
     std::string outputFile = dialog.get_filename();
-    ConfigFileWriter writer(outputFile, modules);
+    ConfigFileWriter writer(outputFile, std::move(modules));
     if (!writer.isOpen()) {
         Gtk::MessageDialog dialog(*this,
             "Failed to open file " + outputFile + ".", false,
@@ -566,7 +567,7 @@ GdfmWindow::onAddModuleItemActivated()
         return;
     std::shared_ptr<Module> module = dialog.getModule();
     if (module)
-        appendModule(*module);
+        appendModule(module);
 }
 
 void
@@ -1033,14 +1034,24 @@ GdfmWindow::onMoveDownButtonClicked()
 void
 GdfmWindow::message(const std::string& message, MessageType type)
 {
-    Gtk::MessageType dialogType;
+    Gtk::MessageType dialogType = Gtk::MESSAGE_INFO;
     switch (type) {
     case MESSAGE_INFO:
         dialogType = Gtk::MESSAGE_INFO;
+        break;
     case MESSAGE_WARNING:
         dialogType = Gtk::MESSAGE_WARNING;
+        break;
     case MESSAGE_ERROR:
         dialogType = Gtk::MESSAGE_ERROR;
+        break;
+    /* A dialog for every piece of output would be unusable. */
+    case MESSAGE_OUTPUT:
+        std::cout << message << std::flush;
+        return;
+    case MESSAGE_ERROR_OUTPUT:
+        std::cerr << message << std::flush;
+        return;
     }
     Gtk::MessageDialog dialog(
         *this, message, false, dialogType, Gtk::BUTTONS_OK, true);
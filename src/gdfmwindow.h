@@ -70,7 +70,7 @@ public:
      * currently editing it.
      */
     bool loadDirectory(const std::string& directoryPath);
-    void setModulesViewFromModules(const std::vector<Module>& modules);
+    void setModulesViewFromModules(std::vector<Module> modules);
     std::string getSourceDirectory() const;
     /*
      * If there is no current filename, then prompts the user for if it is okay
@@ -233,7 +233,11 @@ private:
     void onActionQuit();
     void onActionAbout();
 
-    void appendModule(const Module& module);
+    /*
+     * Adds a row for the module, which the view then shares rather than
+     * keeping its own copy.
+     */
+    void appendModule(std::shared_ptr<Module> module);
 
     /*
      * Gets the row that has the children representing install actions for
@@ -25,11 +25,11 @@
 #include "installaction.h"
 
 #include <dirent.h>
-#include <err.h>
 
 #include <iostream>
 
 #include "abstractwindow.h"
+#include "installstate.h"
 #include "util.h"
 
 namespace dfm {
@@ -138,17 +138,54 @@ InstallAction::performAction()
         destinationPath.c_str());
 
     if (!fileExists(sourcePath)) {
-        warnx(
+        warningMessage(
             "File %s doesn't exist, can't be installed.", sourcePath.c_str());
         return false;
     }
     std::string installDir = shellExpandPath(destinationDirectory);
     if (!ensureDirectoriesExist(installDir)) {
-        warnx(
+        warningMessage(
             "Failed to use destination directory %s, isn't directory or couldn't be created.",
             destinationDirectory.c_str());
     }
-    return copyFile(sourcePath, destinationPath);
+    if (installMode != COPY_INSTALL_MODE) {
+        if (installMode == HARDLINK_INSTALL_MODE && isDirectory(sourcePath)) {
+            warningMessage(
+                "Can't hard link directory %s.", sourcePath.c_str());
+            return false;
+        }
+        /* Symlinks have to work from anywhere. */
+        if (!linkFile(getAbsolutePath(sourcePath), destinationPath,
+                installMode))
+            return false;
+        verboseMessage("Linked %s using a %s.\n\n", sourcePath.c_str(),
+            getInstallModeName(installMode));
+        /* The state only describes copies. */
+        if (getInstallState() != nullptr)
+            getInstallState()->recordRemoval(destinationPath);
+        return true;
+    }
+    CopyMethod usedMethod = CLONE_COPY_METHOD;
+    if (!copyFile(
+            sourcePath, destinationPath, CLONE_COPY_METHOD, &usedMethod))
+        return false;
+    verboseMessage("Copied %s using %s.\n\n", sourcePath.c_str(),
+        getCopyMethodName(usedMethod));
+    if (getInstallState() != nullptr)
+        getInstallState()->recordInstall(sourcePath, destinationPath);
+    return true;
+}
+
+InstallMode
+InstallAction::getInstallMode() const
+{
+    return installMode;
+}
+
+void
+InstallAction::setInstallMode(InstallMode installMode)
+{
+    this->installMode = installMode;
 }
 
 void
@@ -170,6 +207,14 @@ InstallAction::createConfigLines() const
     return lines;
 }
 
+std::vector<std::string>
+InstallAction::getDestinationPaths() const
+{
+    std::vector<std::string> paths;
+    paths.push_back(getInstallationPath());
+    return paths;
+}
+
 void
 InstallAction::graphicalEdit()
 {
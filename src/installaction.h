@@ -28,6 +28,7 @@
 #include <string>
 
 #include "moduleaction.h"
+#include "util.h"
 
 namespace dfm {
 
@@ -51,9 +52,13 @@ public:
     void setDestinationDirectory(const std::string& destinationDirectory);
     const std::string& getInstallFilename() const;
     void setInstallFilename(const std::string& installFilename);
+    InstallMode getInstallMode() const;
+    /* Sets whether the file is copied or linked. Defaults to copying. */
+    void setInstallMode(InstallMode installMode);
 
     void updateName() override;
     std::vector<std::string> createConfigLines() const override;
+    std::vector<std::string> getDestinationPaths() const override;
     void graphicalEdit() override;
 
 private:
@@ -61,6 +66,7 @@ private:
     std::string sourceDirectory;
     std::string installFilename;
     std::string destinationDirectory;
+    InstallMode installMode = COPY_INSTALL_MODE;
 };
 } /* namespace dfm */
 
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "installstate.h"
+
+#include <sys/file.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <fstream>
+
+#include "mappedfile.h"
+#include "util.h"
+
+namespace dfm {
+
+/* Every state file starts with this so that random files aren't read as one. */
+const char STATE_MAGIC[] = "DFMSTATE";
+
+bool
+InstallState::FileMetadata::operator==(const FileMetadata& other) const
+{
+    return size == other.size && modificationTime == other.modificationTime
+        && changeTime == other.changeTime && device == other.device
+        && inode == other.inode && mode == other.mode;
+}
+
+bool
+InstallState::FileMetadata::operator!=(const FileMetadata& other) const
+{
+    return !(*this == other);
+}
+
+InstallState::InstallState(const std::string& path) : path(path)
+{
+}
+
+const std::string&
+InstallState::getPath() const
+{
+    return path;
+}
+
+void
+InstallState::load()
+{
+    std::unordered_map<std::string, InstalledFile> loadedFiles;
+    if (!read(loadedFiles))
+        loadedFiles.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    files = std::move(loadedFiles);
+    changedPaths.clear();
+}
+
+bool
+InstallState::save()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (changedPaths.empty())
+        return true;
+
+    /* The lock is on a separate file since the state file gets replaced. */
+    std::string lockPath = path + ".lock";
+    int lockDescriptor =
+        open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (lockDescriptor == -1)
+        return false;
+    if (flock(lockDescriptor, LOCK_EX) != 0) {
+        close(lockDescriptor);
+        return false;
+    }
+
+    std::unordered_map<std::string, InstalledFile> savedFiles;
+    if (!read(savedFiles))
+        savedFiles.clear();
+    for (const auto& changedPath : changedPaths) {
+        auto position = files.find(changedPath);
+        if (position == files.end())
+            savedFiles.erase(changedPath);
+        else
+            savedFiles[changedPath] = position->second;
+    }
+
+    std::string output(STATE_MAGIC, sizeof(STATE_MAGIC) - 1);
+    writeNumber(output, STATE_VERSION);
+    writeNumber(output, savedFiles.size());
+    for (const auto& entry : savedFiles) {
+        writeString(output, entry.first);
+        writeString(output, entry.second.sourcePath);
+        writeMetadata(output, entry.second.source);
+        writeMetadata(output, entry.second.destination);
+        writeNumber(output, entry.second.hash);
+    }
+
+    bool saved = false;
+    std::string temporaryPath = path + ".tmp";
+    std::ofstream writer(temporaryPath, std::ios::binary);
+    if (writer.is_open()) {
+        writer.write(output.data(), output.size());
+        writer.close();
+        saved = writer && rename(temporaryPath.c_str(), path.c_str()) == 0;
+        if (!saved)
+            remove(temporaryPath.c_str());
+    }
+    flock(lockDescriptor, LOCK_UN);
+    close(lockDescriptor);
+    if (saved)
+        changedPaths.clear();
+    return saved;
+}
+
+void
+InstallState::recordInstall(
+    const std::string& sourcePath, const std::string& destinationPath)
+{
+    InstalledFile file;
+    file.sourcePath = sourcePath;
+    if (!getMetadata(sourcePath, file.source)
+        || !getMetadata(destinationPath, file.destination)
+        || !hashFile(destinationPath, file.hash)) {
+        recordRemoval(destinationPath);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    files[destinationPath] = file;
+    changedPaths.insert(destinationPath);
+}
+
+void
+InstallState::recordRemoval(const std::string& destinationPath)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (files.erase(destinationPath) > 0)
+        changedPaths.insert(destinationPath);
+}
+
+bool
+InstallState::isUnchanged(
+    const std::string& sourcePath, const std::string& destinationPath) const
+{
+    FileMetadata source;
+    FileMetadata destination;
+    if (!getMetadata(sourcePath, source)
+        || !getMetadata(destinationPath, destination))
+        return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto position = files.find(destinationPath);
+    return position != files.end()
+        && position->second.sourcePath == sourcePath
+        && position->second.source == source
+        && position->second.destination == destination;
+}
+
+bool
+InstallState::getDestinationHash(
+    const std::string& destinationPath, uint64_t& hash) const
+{
+    FileMetadata destination;
+    if (!getMetadata(destinationPath, destination))
+        return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto position = files.find(destinationPath);
+    if (position == files.end()
+        || position->second.destination != destination)
+        return false;
+    hash = position->second.hash;
+    return true;
+}
+
+bool
+InstallState::read(
+    std::unordered_map<std::string, InstalledFile>& loadedFiles) const
+{
+    MappedFile stateFile(path);
+    if (!stateFile.isOpen())
+        return false;
+    StringSlice contents = stateFile.getContents();
+    StringSlice magic(STATE_MAGIC, sizeof(STATE_MAGIC) - 1);
+    if (contents.subslice(0, magic.getLength()) != magic)
+        return false;
+
+    const char* current = contents.getData() + magic.getLength();
+    const char* end = contents.getData() + contents.getLength();
+    uint64_t version = 0;
+    uint64_t fileCount = 0;
+    if (!readNumber(current, end, version) || version != STATE_VERSION
+        || !readNumber(current, end, fileCount))
+        return false;
+    for (uint64_t i = 0; i < fileCount; i++) {
+        std::string destinationPath;
+        InstalledFile file;
+        if (!readString(current, end, destinationPath)
+            || !readString(current, end, file.sourcePath)
+            || !readMetadata(current, end, file.source)
+            || !readMetadata(current, end, file.destination)
+            || !readNumber(current, end, file.hash))
+            return false;
+        loadedFiles[destinationPath] = file;
+    }
+    return current == end;
+}
+
+bool
+InstallState::getMetadata(const std::string& path, FileMetadata& metadata)
+{
+    struct stat pathInfo;
+    if (stat(path.c_str(), &pathInfo) != 0 || !S_ISREG(pathInfo.st_mode))
+        return false;
+    metadata.size = pathInfo.st_size;
+    metadata.modificationTime =
+        pathInfo.st_mtim.tv_sec * 1000000000ULL + pathInfo.st_mtim.tv_nsec;
+    metadata.changeTime =
+        pathInfo.st_ctim.tv_sec * 1000000000ULL + pathInfo.st_ctim.tv_nsec;
+    metadata.device = pathInfo.st_dev;
+    metadata.inode = pathInfo.st_ino;
+    metadata.mode = pathInfo.st_mode;
+    return true;
+}
+
+void
+InstallState::writeNumber(std::string& output, uint64_t number)
+{
+    /* Always little endian like the module cache. */
+    for (int i = 0; i < 8; i++)
+        output += static_cast<char>((number >> (i * 8)) & 0xff);
+}
+
+void
+InstallState::writeString(std::string& output, const std::string& string)
+{
+    writeNumber(output, string.length());
+    output += string;
+}
+
+void
+InstallState::writeMetadata(std::string& output, const FileMetadata& metadata)
+{
+    writeNumber(output, metadata.size);
+    writeNumber(output, metadata.modificationTime);
+    writeNumber(output, metadata.changeTime);
+    writeNumber(output, metadata.device);
+    writeNumber(output, metadata.inode);
+    writeNumber(output, metadata.mode);
+}
+
+bool
+InstallState::readNumber(
+    const char*& current, const char* end, uint64_t& number)
+{
+    if (end - current < 8)
+        return false;
+    number = 0;
+    for (int i = 0; i < 8; i++)
+        number |= static_cast<uint64_t>(static_cast<unsigned char>(current[i]))
+            << (i * 8);
+    current += 8;
+    return true;
+}
+
+bool
+InstallState::readString(
+    const char*& current, const char* end, std::string& string)
+{
+    uint64_t length = 0;
+    if (!readNumber(current, end, length))
+        return false;
+    if (static_cast<uint64_t>(end - current) < length)
+        return false;
+    string.assign(current, length);
+    current += length;
+    return true;
+}
+
+bool
+InstallState::readMetadata(
+    const char*& current, const char* end, FileMetadata& metadata)
+{
+    return readNumber(current, end, metadata.size)
+        && readNumber(current, end, metadata.modificationTime)
+        && readNumber(current, end, metadata.changeTime)
+        && readNumber(current, end, metadata.device)
+        && readNumber(current, end, metadata.inode)
+        && readNumber(current, end, metadata.mode);
+}
+} /* namespace dfm */
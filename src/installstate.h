@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef INSTALL_STATE_H
+#define INSTALL_STATE_H
+
+#include "config.h"
+
+#include <sys/stat.h>
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace dfm {
+
+/*
+ * The name of the file in the source directory that the state of installed
+ * files is kept in.
+ */
+const char STATE_FILE_NAME[] = ".dfm.state";
+
+/*
+ * Change this whenever the format of the state file changes so that old ones
+ * are ignored instead of being misread.
+ */
+const uint64_t STATE_VERSION = 1;
+
+/*
+ * Remembers what each installed regular file and its source looked like right
+ * after it was installed, so that checking for updates can tell that neither
+ * has changed from their metadata without reading them.
+ *
+ * Files are looked up by their shell expanded destination path. Every method
+ * is safe to call from more than one thread at once.
+ */
+class InstallState {
+public:
+    InstallState(const std::string& path);
+
+    const std::string& getPath() const;
+
+    /*
+     * Reads the state file. A missing or unreadable state file counts as
+     * having no installed files.
+     */
+    void load();
+    /*
+     * Writes the files that were recorded or removed since loading to the
+     * state file. Other processes may be saving the same state file, so this
+     * holds a lock on it and reads it again before merging in the changes.
+     * It's written to a temporary file first and renamed over the old one.
+     *
+     * Returns true on success, false on failure.
+     */
+    bool save();
+
+    /*
+     * Records that the regular file at sourcePath was just installed to
+     * destinationPath, or that they were found to have the same contents.
+     * Does nothing if either isn't a regular file.
+     */
+    void recordInstall(
+        const std::string& sourcePath, const std::string& destinationPath);
+    /* Forgets the file installed at destinationPath. */
+    void recordRemoval(const std::string& destinationPath);
+
+    /*
+     * Returns true if sourcePath was installed to destinationPath and neither
+     * has changed since, which means that they still have the same contents.
+     */
+    bool isUnchanged(const std::string& sourcePath,
+        const std::string& destinationPath) const;
+    /*
+     * Sets hash to the hash of the file at destinationPath if it hasn't
+     * changed since it was recorded.
+     *
+     * Returns true if hash was set, false otherwise.
+     */
+    bool getDestinationHash(
+        const std::string& destinationPath, uint64_t& hash) const;
+
+private:
+    /* The parts of a stat that change when a file is changed or replaced. */
+    struct FileMetadata {
+        uint64_t size = 0;
+        uint64_t modificationTime = 0;
+        uint64_t changeTime = 0;
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        uint64_t mode = 0;
+
+        bool operator==(const FileMetadata& other) const;
+        bool operator!=(const FileMetadata& other) const;
+    };
+
+    struct InstalledFile {
+        std::string sourcePath;
+        FileMetadata source;
+        FileMetadata destination;
+        uint64_t hash = 0;
+    };
+
+    std::string path;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, InstalledFile> files;
+    /* Destination paths recorded or removed since loading. */
+    std::unordered_set<std::string> changedPaths;
+
+    /*
+     * Reads the state file into loadedFiles.
+     *
+     * Returns true on success, false if it's missing or can't be used.
+     */
+    bool read(std::unordered_map<std::string, InstalledFile>& loadedFiles) const;
+
+    /*
+     * Sets metadata from the file at path.
+     *
+     * Returns true if path is a regular file, false otherwise.
+     */
+    static bool getMetadata(const std::string& path, FileMetadata& metadata);
+
+    static void writeNumber(std::string& output, uint64_t number);
+    static void writeString(std::string& output, const std::string& string);
+    static void writeMetadata(
+        std::string& output, const FileMetadata& metadata);
+
+    /*
+     * These read from current, which is moved past whatever was read, and
+     * fail instead of reading past end.
+     *
+     * Returns true on success, false on failure.
+     */
+    static bool readNumber(
+        const char*& current, const char* end, uint64_t& number);
+    static bool readString(
+        const char*& current, const char* end, std::string& string);
+    static bool readMetadata(
+        const char*& current, const char* end, FileMetadata& metadata);
+};
+} /* namespace dfm */
+
+#endif /* INSTALL_STATE_H */
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "mappedfile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <err.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace dfm {
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(const std::string& path)
+{
+    open(path);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool
+MappedFile::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    /*
+     * Mapping a zero length file fails, but there's nothing to map anyways so
+     * it's treated like an open empty file.
+     */
+    if (S_ISREG(fileInfo.st_mode) && fileInfo.st_size > 0) {
+        void* address = mmap(nullptr, fileInfo.st_size, PROT_READ,
+            MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            /* The file is only ever read from front to back. */
+            madvise(address, fileInfo.st_size, MADV_SEQUENTIAL);
+            ::close(fd);
+            data = static_cast<const char*>(address);
+            size = fileInfo.st_size;
+            mapped = true;
+            opened = true;
+            return true;
+        }
+    }
+
+    char readBuffer[FILE_MAP_READ_SIZE];
+    ssize_t bytesRead = read(fd, readBuffer, FILE_MAP_READ_SIZE);
+    while (bytesRead > 0) {
+        buffer.append(readBuffer, bytesRead);
+        bytesRead = read(fd, readBuffer, FILE_MAP_READ_SIZE);
+    }
+    ::close(fd);
+    if (bytesRead == -1) {
+        warn("Failed to read %s", path.c_str());
+        buffer.clear();
+        return false;
+    }
+    data = buffer.data();
+    size = buffer.size();
+    opened = true;
+    return true;
+}
+
+bool
+MappedFile::isOpen() const
+{
+    return opened;
+}
+
+void
+MappedFile::close()
+{
+    if (mapped)
+        munmap(const_cast<char*>(data), size);
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+    mapped = false;
+    opened = false;
+}
+
+const char*
+MappedFile::getData() const
+{
+    return data;
+}
+
+size_t
+MappedFile::getSize() const
+{
+    return size;
+}
+
+StringSlice
+MappedFile::getContents() const
+{
+    return StringSlice(data, size);
+}
+} /* namespace dfm */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "config.h"
+
+#include <stddef.h>
+
+#include <string>
+
+#include "stringslice.h"
+
+namespace dfm {
+
+/*
+ * The size of the buffer to use when a file can't be mapped and has to be
+ * read instead.
+ */
+const size_t FILE_MAP_READ_SIZE = 65536;
+
+/*
+ * Maps the whole contents of a file into memory as read only so it can be
+ * handed out as slices without copying it. If the file can't be mapped, like
+ * if it's a pipe, then its contents are read into memory instead so that it
+ * works the same either way.
+ *
+ * Slices of the contents are only valid until the file is closed or the
+ * MappedFile is destroyed.
+ */
+class MappedFile {
+public:
+    MappedFile();
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    /* Copying would mean unmapping twice, so it isn't allowed. */
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /*
+     * Opens the file at path, closing the current one first if there is one.
+     *
+     * Returns true on success, false on failure.
+     */
+    bool open(const std::string& path);
+    bool isOpen() const;
+    void close();
+
+    const char* getData() const;
+    size_t getSize() const;
+    StringSlice getContents() const;
+
+private:
+    bool opened = false;
+    /* Set if the contents were mapped instead of being read into buffer. */
+    bool mapped = false;
+    const char* data = nullptr;
+    size_t size = 0;
+    std::string buffer;
+};
+} /* namespace dfm */
+
+#endif /* MAPPED_FILE_H */
@@ -26,8 +26,45 @@
 
 #include <err.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <utility>
+
+#include "shellaction.h"
+#include "util.h"
+
 namespace dfm {
 
+/* Returns the first index in the group that index is in. */
+static int
+findGroup(std::vector<int>& groups, int index)
+{
+    while (groups[index] != index) {
+        groups[index] = groups[groups[index]];
+        index = groups[index];
+    }
+    return index;
+}
+
+/*
+ * Returns name as a config file argument, which has to be quoted if it has
+ * white space in it.
+ */
+static std::string
+quoteModuleName(const std::string& name)
+{
+    if (name.find_first_of(" \t\"\\") == std::string::npos)
+        return name;
+    std::string quoted = "\"";
+    for (char character : name) {
+        if (character == '"' || character == '\\')
+            quoted += '\\';
+        quoted += character;
+    }
+    return quoted + "\"";
+}
+
 Module::Module() : name(DEFAULT_MODULE_NAMES)
 {
 }
@@ -51,44 +88,35 @@ Module::setName(const std::string& name)
 bool
 Module::install(const std::string& sourceDirectory) const
 {
-    for (const auto& file : files) {
-        std::shared_ptr<InstallAction> installAction =
-            file.createInstallAction(sourceDirectory);
-        if (!installAction->performAction()) {
-            warnx("Failed to perform install action \"%s\".",
-                installAction->getName().c_str());
-            return false;
-        }
-    }
-    for (const auto& action : installActions) {
-        if (!action->performAction()) {
-            warnx("Failed to perform install action \"%s\".",
-                action->getName().c_str());
-            return false;
-        }
+    std::vector<std::shared_ptr<ModuleAction>> fileActions;
+    for (const auto& file : files)
+        fileActions.push_back(file.createInstallAction(sourceDirectory));
+    for (auto& action : fileActions) {
+        action->setInstallState(installState);
+        action->setVerbose(verbose);
     }
-    return true;
+    if (!performFileActions(fileActions, "install"))
+        return false;
+    if (!performActions(installActions, "install"))
+        return false;
+    /* The actions can copy files too. */
+    return syncPendingFiles();
 }
 
 bool
 Module::uninstall(const std::string& sourceDirectory) const
 {
-    for (const auto& file : files) {
-        std::shared_ptr<RemoveAction> uninstallAction =
-            file.createUninstallAction();
-        if (!uninstallAction->performAction()) {
-            warnx("Failed to perform uninstall action \"%s\".",
-                uninstallAction->getName().c_str());
-            return false;
-        }
-    }
-    for (const auto& action : uninstallActions) {
-        if (!action->performAction()) {
-            warnx("Failed to perform uninstall action \"%s\".",
-                action->getName().c_str());
-            return false;
-        }
+    std::vector<std::shared_ptr<ModuleAction>> fileActions;
+    for (const auto& file : files)
+        fileActions.push_back(file.createUninstallAction(sourceDirectory));
+    for (auto& action : fileActions) {
+        action->setInstallState(installState);
+        action->setVerbose(verbose);
     }
+    if (!performFileActions(fileActions, "uninstall"))
+        return false;
+    if (!performActions(uninstallActions, "uninstall"))
+        return false;
     return true;
 }
 
@@ -96,23 +124,22 @@ Module::uninstall(const std::string& sourceDirectory) const
 bool
 Module::update(const std::string& sourceDirectory) const
 {
+    std::vector<std::shared_ptr<ModuleAction>> fileActions;
     for (const auto& file : files) {
-        std::shared_ptr<FileCheckAction> updateAction =
-            file.createUpdateAction(sourceDirectory);
-        if (!updateAction->performAction()) {
-            warnx("Failed to perform update action \"%s\".",
-                updateAction->getName().c_str());
-            return false;
-        }
+        auto action = file.createUpdateAction(sourceDirectory);
+        action->setPruneExtraFiles(pruneExtraFiles);
+        fileActions.push_back(action);
     }
-    for (const auto& action : updateActions) {
-        if (!action->performAction()) {
-            warnx("Failed to perform update action \"%s\".",
-                action->getName().c_str());
-            return false;
-        }
+    for (auto& action : fileActions) {
+        action->setInstallState(installState);
+        action->setVerbose(verbose);
     }
-    return true;
+    if (!performFileActions(fileActions, "update"))
+        return false;
+    if (!performActions(updateActions, "update"))
+        return false;
+    /* The actions can copy files too. */
+    return syncPendingFiles();
 }
 
 void
@@ -151,6 +178,12 @@ Module::getUpdateActions() const
     return updateActions;
 }
 
+void
+Module::addFile(const ModuleFile& file)
+{
+    files.push_back(file);
+}
+
 void
 Module::addFile(const std::string& filename)
 {
@@ -173,7 +206,7 @@ Module::addFile(const std::string& filename,
         ModuleFile(filename, destinationDirectory, destinationFilename));
 }
 
-const std::vector<ModuleFile>
+const std::vector<ModuleFile>&
 Module::getFiles() const
 {
     return files;
@@ -184,8 +217,26 @@ Module::createConfigLines() const
 {
     std::vector<std::string> lines;
     lines.push_back(name + ":");
-    for (const auto& file : files)
-        lines.push_back("\t" + file.createConfigLines()[0]);
+    /* Linked files go under a header for each kind of link. */
+    const InstallMode modes[] = { COPY_INSTALL_MODE, SYMLINK_INSTALL_MODE,
+        HARDLINK_INSTALL_MODE };
+    const char* modeHeaders[] = { nullptr, "link:", "hardlink:" };
+    for (int i = 0; i < 3; i++) {
+        bool hasHeader = modeHeaders[i] == nullptr;
+        for (const auto& file : files) {
+            if (file.getInstallMode() != modes[i])
+                continue;
+            if (!hasHeader) {
+                lines.push_back(modeHeaders[i]);
+                hasHeader = true;
+            }
+            lines.push_back("\t" + file.createConfigLines()[0]);
+        }
+    }
+    if (requirements.size() > 0)
+        lines.push_back("requires:");
+    for (const auto& requirement : requirements)
+        lines.push_back("\t" + quoteModuleName(requirement));
     if (installActions.size() > 0)
         lines.push_back("install:");
     /*
@@ -211,12 +262,132 @@ Module::createConfigLines() const
     return lines;
 }
 
+const std::vector<std::string>&
+Module::getRequirements() const
+{
+    return requirements;
+}
+
+void
+Module::addRequirement(const std::string& moduleName)
+{
+    requirements.push_back(moduleName);
+}
+
 AbstractWindow*
 Module::getWindow() const
 {
     return window;
 }
 
+bool
+Module::performFileActions(
+    const std::vector<std::shared_ptr<ModuleAction>>& fileActions,
+    const char* operationName) const
+{
+    int actionCount = fileActions.size();
+    /*
+     * Files that overlap are put in the same group, and each group is done
+     * in order by a single thread.
+     */
+    std::vector<std::pair<std::string, int>> paths;
+    for (int i = 0; i < actionCount; i++)
+        paths.push_back(std::make_pair(files[i].getDestinationPath(), i));
+    std::vector<int> groups(actionCount);
+    for (int i = 0; i < actionCount; i++)
+        groups[i] = i;
+    for (const auto& overlap : findOverlappingPaths(std::move(paths))) {
+        int firstGroup = findGroup(groups, overlap.first);
+        int secondGroup = findGroup(groups, overlap.second);
+        groups[std::max(firstGroup, secondGroup)] =
+            std::min(firstGroup, secondGroup);
+    }
+    std::vector<std::vector<int>> groupActions;
+    std::vector<int> groupPositions(actionCount, -1);
+    for (int i = 0; i < actionCount; i++) {
+        int group = findGroup(groups, i);
+        if (groupPositions[group] == -1) {
+            groupPositions[group] = groupActions.size();
+            groupActions.push_back(std::vector<int>());
+        }
+        groupActions[groupPositions[group]].push_back(i);
+    }
+
+    /* Not a vector<bool> so that threads can set different entries. */
+    std::vector<char> failed(actionCount, false);
+    std::atomic<size_t> nextGroup(0);
+    auto performGroups = [&]() {
+        for (size_t group = nextGroup++; group < groupActions.size();
+             group = nextGroup++) {
+            for (int action : groupActions[group])
+                failed[action] = !fileActions[action]->performAction();
+        }
+    };
+    /* The actions mostly wait on the disk, so this doesn't go by core count. */
+    unsigned int threadCount =
+        std::min<size_t>(MAX_FILE_THREADS, groupActions.size());
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < threadCount; i++)
+        threads.push_back(std::thread(performGroups));
+    performGroups();
+    for (auto& thread : threads)
+        thread.join();
+
+    bool noErrors = true;
+    for (int i = 0; i < actionCount; i++) {
+        if (failed[i]) {
+            warnx("Failed to perform %s action \"%s\".", operationName,
+                fileActions[i]->getName().c_str());
+            noErrors = false;
+        }
+    }
+    if (!syncPendingFiles()) {
+        warnx("Failed to write the files of module \"%s\" to the disk.",
+            name.c_str());
+        noErrors = false;
+    }
+    return noErrors;
+}
+
+bool
+Module::performActions(
+    const std::vector<std::shared_ptr<ModuleAction>>& actions,
+    const char* operationName) const
+{
+    size_t i = 0;
+    while (i < actions.size()) {
+        std::vector<ShellAction*> group;
+        for (; i < actions.size(); i++) {
+            auto shell = std::dynamic_pointer_cast<ShellAction>(actions[i]);
+            if (shell == nullptr || !shell->isParallelSafe())
+                break;
+            group.push_back(shell.get());
+        }
+        /* A lone command may as well use the persistent shell. */
+        if (group.size() > 1) {
+            std::vector<bool> succeeded;
+            if (ShellAction::performActions(group, succeeded))
+                continue;
+            for (size_t j = 0; j < group.size(); j++) {
+                if (!succeeded[j])
+                    warnx("Failed to perform %s action \"%s\".",
+                        operationName, group[j]->getName().c_str());
+            }
+            return false;
+        }
+        /* Either way, what's left is one action just before i. */
+        if (group.empty())
+            i++;
+        const auto& action = actions[i - 1];
+        if (!action->performAction()) {
+            warnx("Failed to perform %s action \"%s\".", operationName,
+                action->getName().c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
 void
 Module::setWindow(AbstractWindow* window)
 {
@@ -230,4 +401,46 @@ Module::setWindow(AbstractWindow* window)
     for (auto& module : updateActions)
         module->setWindow(window);
 }
+
+InstallState*
+Module::getInstallState() const
+{
+    return installState;
+}
+
+void
+Module::setInstallState(InstallState* installState)
+{
+    this->installState = installState;
+    for (auto& action : installActions)
+        action->setInstallState(installState);
+    for (auto& action : uninstallActions)
+        action->setInstallState(installState);
+    for (auto& action : updateActions)
+        action->setInstallState(installState);
+}
+
+bool
+Module::isVerbose() const
+{
+    return verbose;
+}
+
+void
+Module::setVerbose(bool verbose)
+{
+    this->verbose = verbose;
+}
+
+bool
+Module::prunesExtraFiles() const
+{
+    return pruneExtraFiles;
+}
+
+void
+Module::setPruneExtraFiles(bool pruneExtraFiles)
+{
+    this->pruneExtraFiles = pruneExtraFiles;
+}
 } /* namespace dfm */
@@ -36,11 +36,22 @@
 namespace dfm {
 
 const char DEFAULT_MODULE_NAMES[] = "Generic Module";
+/* The most threads to use when operating on the files of a module. */
+const unsigned int MAX_FILE_THREADS = 8;
 
 class Module {
 public:
     Module();
     Module(const std::string& name);
+    /*
+     * Modules are only moved, never copied, so that a module read from the
+     * config file is the same one that gets performed and written back out.
+     */
+    Module(const Module& module) = delete;
+    Module(Module&& module) = default;
+    Module& operator=(const Module& module) = delete;
+    Module& operator=(Module&& module) = default;
+    void addFile(const ModuleFile& file);
     void addFile(const std::string& filename);
     void addFile(
         const std::string& filename, const std::string& destinationDirectory);
@@ -60,20 +71,69 @@ public:
     const std::vector<std::shared_ptr<ModuleAction>>& getUpdateActions() const;
     const std::string& getName() const;
     void setName(const std::string& name);
-    const std::vector<ModuleFile> getFiles() const;
+    const std::vector<ModuleFile>& getFiles() const;
+    /* Returns the names of the modules that this one requires. */
+    const std::vector<std::string>& getRequirements() const;
+    /*
+     * Adds a module that has to be installed before this one and uninstalled
+     * after it.
+     */
+    void addRequirement(const std::string& moduleName);
     AbstractWindow* getWindow() const;
     /* Note, this also sets all ModuleActions as well. */
     void setWindow(AbstractWindow* window);
+    InstallState* getInstallState() const;
+    /*
+     * Sets where installed files are recorded for this module and all of its
+     * actions, or null to not record them.
+     */
+    void setInstallState(InstallState* installState);
+    bool isVerbose() const;
+    /* Sets whether the actions made for each file say what they're doing. */
+    void setVerbose(bool verbose);
+    bool prunesExtraFiles() const;
+    /*
+     * Sets whether updating a directory removes files in it that aren't in
+     * the source.
+     */
+    void setPruneExtraFiles(bool pruneExtraFiles);
 
     std::vector<std::string> createConfigLines() const;
 
 private:
     std::string name;
     std::vector<ModuleFile> files;
+    std::vector<std::string> requirements;
     std::vector<std::shared_ptr<ModuleAction>> installActions;
     std::vector<std::shared_ptr<ModuleAction>> uninstallActions;
     std::vector<std::shared_ptr<ModuleAction>> updateActions;
     AbstractWindow* window = nullptr;
+    InstallState* installState = nullptr;
+    bool verbose = false;
+    bool pruneExtraFiles = false;
+
+    /*
+     * Performs the action for each file, with actions for different files
+     * running at the same time. Actions whose destination paths are the same
+     * or inside of each other are still performed in order. Gives a warning
+     * naming every action that failed, where operationName is the operation
+     * being performed like "install".
+     *
+     * Returns true if every action succeeded, false otherwise.
+     */
+    bool performFileActions(
+        const std::vector<std::shared_ptr<ModuleAction>>& fileActions,
+        const char* operationName) const;
+    /*
+     * Performs the actions in order, except that a run of parallel safe shell
+     * actions is performed all at once. Stops at the first failure and gives
+     * a warning naming what failed, where operationName is like "install".
+     *
+     * Returns true if every action succeeded, false otherwise.
+     */
+    bool performActions(
+        const std::vector<std::shared_ptr<ModuleAction>>& actions,
+        const char* operationName) const;
 };
 } /* namespace dfm */
 
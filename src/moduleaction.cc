@@ -24,8 +24,11 @@
 
 #include "moduleaction.h"
 
+#include <err.h>
 #include <stdio.h>
 
+#include "abstractwindow.h"
+
 namespace dfm {
 
 ModuleAction::ModuleAction() : name(DEFAULT_ACTION_NAME)
@@ -93,6 +96,32 @@ ModuleAction::vVerboseMessage(const char* format, va_list argumentList)
     vprintf(format, argumentList);
 }
 
+void
+ModuleAction::warningMessage(const char* format, ...) const
+{
+    va_list argumentList;
+    va_start(argumentList, format);
+    /* The lock is recursive, so vwarnx can still take it. */
+    flockfile(stderr);
+    vwarnx(format, argumentList);
+    funlockfile(stderr);
+    va_end(argumentList);
+}
+
+void
+ModuleAction::outputMessage(const char* data, size_t size, bool isError) const
+{
+    if (window != nullptr) {
+        window->message(std::string(data, size),
+            (isError) ? AbstractWindow::MESSAGE_ERROR_OUTPUT
+                      : AbstractWindow::MESSAGE_OUTPUT);
+        return;
+    }
+    FILE* stream = (isError) ? stderr : stdout;
+    fwrite(data, 1, size, stream);
+    fflush(stream);
+}
+
 void
 ModuleAction::updateName()
 {
@@ -105,6 +134,12 @@ ModuleAction::createConfigLines() const
     return std::vector<std::string>();
 }
 
+std::vector<std::string>
+ModuleAction::getDestinationPaths() const
+{
+    return std::vector<std::string>();
+}
+
 void
 ModuleAction::graphicalEdit()
 {
@@ -122,4 +157,16 @@ ModuleAction::setWindow(AbstractWindow* window)
 {
     this->window = window;
 }
+
+InstallState*
+ModuleAction::getInstallState() const
+{
+    return installState;
+}
+
+void
+ModuleAction::setInstallState(InstallState* installState)
+{
+    this->installState = installState;
+}
 } /* namespace dfm */
@@ -34,6 +34,7 @@ namespace dfm {
 
 /* Forward declaration to prevent circular dependency. */
 class AbstractWindow;
+class InstallState;
 
 const char DEFAULT_ACTION_NAME[] = "generic action";
 
@@ -45,6 +46,16 @@ public:
 
     void verboseMessage(const char* format, ...);
     void vVerboseMessage(const char* format, va_list argumentList);
+    /*
+     * Gives a warning like warnx, but all at once so that it doesn't get mixed
+     * up with warnings from actions running on other threads.
+     */
+    void warningMessage(const char* format, ...) const;
+    /*
+     * Passes on output from a command that the action ran to the window, or
+     * writes it to standard output or standard error if there isn't one.
+     */
+    void outputMessage(const char* data, size_t size, bool isError) const;
 
     const std::string& getName() const;
     void setName(const std::string& name);
@@ -74,8 +85,20 @@ public:
      * the given command.
      */
     virtual std::vector<std::string> createConfigLines() const;
+    /*
+     * Returns the paths that performing the action writes to or removes,
+     * without shell expansion. This is used to tell which modules can be
+     * operated on at the same time, and is empty for actions that don't touch
+     * files on their own.
+     */
+    virtual std::vector<std::string> getDestinationPaths() const;
     AbstractWindow* getWindow() const;
     void setWindow(AbstractWindow* window);
+    InstallState* getInstallState() const;
+    /*
+     * Sets where installed files are recorded, and null to not record them.
+     */
+    void setInstallState(InstallState* installState);
     /*
      * Edit the action using a gui if available. This functional is probably
      * not going to be called in the command line version.
@@ -88,6 +111,7 @@ private:
     bool interactive = false;
     /* For making dialogs. Null if no window is available. */
     AbstractWindow* window = nullptr;
+    InstallState* installState = nullptr;
 };
 } /* namespace dfm */
 
@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "modulecache.h"
+
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+
+#include "dependencyaction.h"
+#include "filecheckaction.h"
+#include "installaction.h"
+#include "mappedfile.h"
+#include "messageaction.h"
+#include "removeaction.h"
+#include "shellaction.h"
+#include "util.h"
+
+namespace dfm {
+
+/* Every cache starts with this so that random files aren't read as one. */
+const char CACHE_MAGIC[] = "DFMCACHE";
+
+ModuleCache::ModuleCache(const std::string& path) : path(path)
+{
+}
+
+const std::string&
+ModuleCache::getPath() const
+{
+    return path;
+}
+
+bool
+ModuleCache::load(const std::string& configPath,
+    const StringSlice& configContents, const std::string& key,
+    std::vector<Module>& modules, ReaderEnvironment& environment) const
+{
+    std::string header;
+    if (!createHeader(configPath, configContents, key, header))
+        return false;
+    MappedFile cacheFile(path);
+    if (!cacheFile.isOpen())
+        return false;
+    StringSlice contents = cacheFile.getContents();
+    if (contents.subslice(0, header.length()) != StringSlice(header))
+        return false;
+
+    const char* current = contents.getData() + header.length();
+    const char* end = contents.getData() + contents.getLength();
+    uint64_t variableCount = 0;
+    if (!readNumber(current, end, variableCount))
+        return false;
+    std::vector<std::string> variables;
+    for (uint64_t i = 0; i < variableCount * 2; i++) {
+        std::string string;
+        if (!readString(current, end, string))
+            return false;
+        variables.push_back(string);
+    }
+
+    uint64_t moduleCount = 0;
+    if (!readNumber(current, end, moduleCount))
+        return false;
+    std::vector<Module> loadedModules;
+    for (uint64_t i = 0; i < moduleCount; i++) {
+        std::string name;
+        if (!readString(current, end, name))
+            return false;
+        Module module(name);
+        uint64_t fileCount = 0;
+        if (!readNumber(current, end, fileCount))
+            return false;
+        for (uint64_t j = 0; j < fileCount; j++) {
+            std::string filename;
+            std::string destinationDirectory;
+            std::string destinationFilename;
+            uint64_t installMode = 0;
+            if (!readString(current, end, filename)
+                || !readString(current, end, destinationDirectory)
+                || !readString(current, end, destinationFilename)
+                || !readNumber(current, end, installMode)
+                || installMode > HARDLINK_INSTALL_MODE)
+                return false;
+            ModuleFile file(
+                filename, destinationDirectory, destinationFilename);
+            file.setInstallMode(static_cast<InstallMode>(installMode));
+            module.addFile(file);
+        }
+        std::vector<std::string> requirements;
+        if (!readStrings(current, end, requirements))
+            return false;
+        for (const auto& requirement : requirements)
+            module.addRequirement(requirement);
+        std::vector<std::shared_ptr<ModuleAction>> actions;
+        if (!readActions(current, end, environment.getArena(), actions))
+            return false;
+        for (const auto& action : actions)
+            module.addInstallAction(action);
+        if (!readActions(current, end, environment.getArena(), actions))
+            return false;
+        for (const auto& action : actions)
+            module.addUninstallAction(action);
+        if (!readActions(current, end, environment.getArena(), actions))
+            return false;
+        for (const auto& action : actions)
+            module.addUpdateAction(action);
+        loadedModules.push_back(std::move(module));
+    }
+    if (current != end)
+        return false;
+
+    for (std::vector<std::string>::size_type i = 0; i < variables.size();
+         i += 2)
+        environment.setVariable(variables[i], variables[i + 1]);
+    for (auto& module : loadedModules)
+        modules.push_back(std::move(module));
+    return true;
+}
+
+bool
+ModuleCache::save(const std::string& configPath,
+    const StringSlice& configContents, const std::string& key,
+    const std::vector<Module>& modules, const ReaderEnvironment& environment,
+    std::string* uncachedModule) const
+{
+    std::string output;
+    if (!createHeader(configPath, configContents, key, output))
+        return false;
+
+    writeNumber(output, environment.getVariables().size());
+    for (const auto& variable : environment.getVariables()) {
+        writeString(output, variable.first);
+        writeString(output, variable.second);
+    }
+
+    writeNumber(output, modules.size());
+    for (const auto& module : modules) {
+        writeString(output, module.getName());
+        const std::vector<ModuleFile>& files = module.getFiles();
+        writeNumber(output, files.size());
+        for (const auto& file : files) {
+            writeString(output, file.getFilename());
+            writeString(output, file.getDestinationDirectory());
+            writeString(output, file.getDestinationFilename());
+            writeNumber(output, file.getInstallMode());
+        }
+        writeStrings(output, module.getRequirements());
+        if (!writeActions(output, module.getInstallActions())
+            || !writeActions(output, module.getUninstallActions())
+            || !writeActions(output, module.getUpdateActions())) {
+            if (uncachedModule != nullptr)
+                *uncachedModule = module.getName();
+            return false;
+        }
+    }
+
+    int descriptor = -1;
+    std::string temporaryPath = createTemporaryPath(path, false, descriptor);
+    if (temporaryPath.empty())
+        return false;
+    close(descriptor);
+    std::ofstream writer(temporaryPath, std::ios::binary);
+    writer.write(output.data(), output.size());
+    writer.close();
+    if (!writer) {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+    if (rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool
+ModuleCache::createHeader(const std::string& configPath,
+    const StringSlice& configContents, const std::string& key,
+    std::string& header)
+{
+    struct stat configInfo;
+    if (stat(configPath.c_str(), &configInfo) != 0)
+        return false;
+    header.assign(CACHE_MAGIC, sizeof(CACHE_MAGIC) - 1);
+    writeNumber(header, CACHE_VERSION);
+    writeNumber(header, configInfo.st_size);
+    writeNumber(header, configInfo.st_mtim.tv_sec);
+    writeNumber(header, configInfo.st_mtim.tv_nsec);
+    writeNumber(header,
+        hashBytes(configContents.getData(), configContents.getLength()));
+    writeString(header, key);
+    return true;
+}
+
+void
+ModuleCache::writeNumber(std::string& output, uint64_t number)
+{
+    /* Always little endian so a cache means the same thing everywhere. */
+    for (int i = 0; i < 8; i++)
+        output += static_cast<char>((number >> (i * 8)) & 0xff);
+}
+
+void
+ModuleCache::writeString(std::string& output, const std::string& string)
+{
+    writeNumber(output, string.length());
+    output += string;
+}
+
+void
+ModuleCache::writeStrings(
+    std::string& output, const std::vector<std::string>& strings)
+{
+    writeNumber(output, strings.size());
+    for (const auto& string : strings)
+        writeString(output, string);
+}
+
+bool
+ModuleCache::writeActions(std::string& output,
+    const std::vector<std::shared_ptr<ModuleAction>>& actions)
+{
+    writeNumber(output, actions.size());
+    for (const auto& action : actions) {
+        if (!writeAction(output, action))
+            return false;
+    }
+    return true;
+}
+
+bool
+ModuleCache::writeAction(
+    std::string& output, const std::shared_ptr<ModuleAction>& action)
+{
+    if (!action)
+        return false;
+    if (auto message = std::dynamic_pointer_cast<MessageAction>(action)) {
+        writeNumber(output, MESSAGE_ACTION);
+        writeString(output, message->getMessage());
+    } else if (auto dependency =
+                   std::dynamic_pointer_cast<DependencyAction>(action)) {
+        writeNumber(output, DEPENDENCY_ACTION);
+        writeStrings(output, dependency->getDependencies());
+    } else if (auto remove = std::dynamic_pointer_cast<RemoveAction>(action)) {
+        writeNumber(output, REMOVE_ACTION);
+        writeString(output, remove->getFilePath());
+    } else if (auto install =
+                   std::dynamic_pointer_cast<InstallAction>(action)) {
+        writeNumber(output, INSTALL_ACTION);
+        writeString(output, install->getFilename());
+        writeString(output, install->getSourceDirectory());
+        writeString(output, install->getInstallFilename());
+        writeString(output, install->getDestinationDirectory());
+    } else if (auto shell = std::dynamic_pointer_cast<ShellAction>(action)) {
+        writeNumber(output, SHELL_ACTION);
+        writeStrings(output, shell->getShellCommands());
+        writeNumber(output, shell->getTimeout());
+        writeNumber(output, shell->isParallelSafe());
+    } else if (auto fileCheck =
+                   std::dynamic_pointer_cast<FileCheckAction>(action)) {
+        writeNumber(output, FILE_CHECK_ACTION);
+        writeString(output, fileCheck->getSourcePath());
+        writeString(output, fileCheck->getDestinationPath());
+    } else {
+        /* Actions made by commands added from outside can't be cached. */
+        return false;
+    }
+    writeString(output, action->getName());
+    writeNumber(output, action->isVerbose());
+    writeNumber(output, action->isInteractive());
+    return true;
+}
+
+bool
+ModuleCache::readNumber(const char*& current, const char* end, uint64_t& number)
+{
+    if (end - current < 8)
+        return false;
+    number = 0;
+    for (int i = 0; i < 8; i++)
+        number |= static_cast<uint64_t>(static_cast<unsigned char>(current[i]))
+            << (i * 8);
+    current += 8;
+    return true;
+}
+
+bool
+ModuleCache::readString(
+    const char*& current, const char* end, std::string& string)
+{
+    uint64_t length = 0;
+    if (!readNumber(current, end, length))
+        return false;
+    if (static_cast<uint64_t>(end - current) < length)
+        return false;
+    string.assign(current, length);
+    current += length;
+    return true;
+}
+
+bool
+ModuleCache::readStrings(const char*& current, const char* end,
+    std::vector<std::string>& strings)
+{
+    uint64_t count = 0;
+    if (!readNumber(current, end, count))
+        return false;
+    strings.clear();
+    for (uint64_t i = 0; i < count; i++) {
+        std::string string;
+        if (!readString(current, end, string))
+            return false;
+        strings.push_back(string);
+    }
+    return true;
+}
+
+bool
+ModuleCache::readActions(const char*& current, const char* end,
+    const std::shared_ptr<Arena>& arena,
+    std::vector<std::shared_ptr<ModuleAction>>& actions)
+{
+    uint64_t count = 0;
+    if (!readNumber(current, end, count))
+        return false;
+    actions.clear();
+    for (uint64_t i = 0; i < count; i++) {
+        std::shared_ptr<ModuleAction> action;
+        if (!readAction(current, end, arena, action))
+            return false;
+        actions.push_back(action);
+    }
+    return true;
+}
+
+bool
+ModuleCache::readAction(const char*& current, const char* end,
+    const std::shared_ptr<Arena>& arena,
+    std::shared_ptr<ModuleAction>& action)
+{
+    uint64_t type = NO_ACTION;
+    if (!readNumber(current, end, type))
+        return false;
+    switch (type) {
+    case MESSAGE_ACTION: {
+        std::string message;
+        if (!readString(current, end, message))
+            return false;
+        action = makeArenaShared<MessageAction>(arena, message);
+        break;
+    }
+    case DEPENDENCY_ACTION: {
+        std::vector<std::string> dependencies;
+        if (!readStrings(current, end, dependencies))
+            return false;
+        action = makeArenaShared<DependencyAction>(arena, dependencies);
+        break;
+    }
+    case REMOVE_ACTION: {
+        std::string filePath;
+        if (!readString(current, end, filePath))
+            return false;
+        action = makeArenaShared<RemoveAction>(arena, filePath);
+        break;
+    }
+    case INSTALL_ACTION: {
+        std::string filename;
+        std::string sourceDirectory;
+        std::string installFilename;
+        std::string destinationDirectory;
+        if (!readString(current, end, filename)
+            || !readString(current, end, sourceDirectory)
+            || !readString(current, end, installFilename)
+            || !readString(current, end, destinationDirectory))
+            return false;
+        action = makeArenaShared<InstallAction>(arena, filename,
+            sourceDirectory, installFilename, destinationDirectory);
+        break;
+    }
+    case SHELL_ACTION: {
+        std::vector<std::string> shellCommands;
+        uint64_t timeout = 0;
+        uint64_t parallelSafe = 0;
+        if (!readStrings(current, end, shellCommands)
+            || !readNumber(current, end, timeout)
+            || !readNumber(current, end, parallelSafe))
+            return false;
+        auto shellAction = makeArenaShared<ShellAction>(arena);
+        shellAction->setShellCommands(shellCommands);
+        shellAction->setTimeout(timeout);
+        shellAction->setParallelSafe(parallelSafe != 0);
+        action = shellAction;
+        break;
+    }
+    case FILE_CHECK_ACTION: {
+        std::string sourcePath;
+        std::string destinationPath;
+        if (!readString(current, end, sourcePath)
+            || !readString(current, end, destinationPath))
+            return false;
+        action = makeArenaShared<FileCheckAction>(
+            arena, sourcePath, destinationPath);
+        break;
+    }
+    default:
+        return false;
+    }
+
+    std::string name;
+    uint64_t verbose = 0;
+    uint64_t interactive = 0;
+    if (!readString(current, end, name) || !readNumber(current, end, verbose)
+        || !readNumber(current, end, interactive))
+        return false;
+    action->setName(name);
+    action->setVerbose(verbose != 0);
+    action->setInteractive(interactive != 0);
+    return true;
+}
+} /* namespace dfm */
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MODULE_CACHE_H
+#define MODULE_CACHE_H
+
+#include "config.h"
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "module.h"
+#include "readerenvironment.h"
+#include "stringslice.h"
+
+namespace dfm {
+
+/*
+ * The name of the file in the source directory that a compiled copy of the
+ * config file is kept in.
+ */
+const char CACHE_FILE_NAME[] = ".config.dfm.cache";
+
+/*
+ * Change this whenever the format of the cache changes so that old caches are
+ * ignored instead of being misread.
+ */
+const uint64_t CACHE_VERSION = 5;
+
+/*
+ * A compact binary copy of the modules and variables read from a config file
+ * so that they can be loaded without parsing it again. A cache is only used
+ * if the size, modification time, and hash of the config file's contents are
+ * the same as when it was written.
+ *
+ * Parsing also depends on things outside the config file, like the source
+ * directory and home directory, and the caller has to describe all of those
+ * with a key. The cache is ignored if the key is different.
+ */
+class ModuleCache {
+public:
+    ModuleCache(const std::string& path);
+
+    const std::string& getPath() const;
+
+    /*
+     * Loads modules and variables from the cache if it is up to date with
+     * the config file at configPath whose contents are configContents.
+     * Doesn't change modules or environment if the cache can't be used.
+     *
+     * Returns true if the cache was loaded, false otherwise.
+     */
+    bool load(const std::string& configPath, const StringSlice& configContents,
+        const std::string& key, std::vector<Module>& modules,
+        ReaderEnvironment& environment) const;
+    /*
+     * Writes the given modules and the variables in environment to the cache
+     * for the config file at configPath. The cache is written to a temporary
+     * file first and renamed over the old one, so a cache is never seen half
+     * written. Nothing is written if a module has an action that can't be
+     * cached, and then uncachedModule is set to its name if it isn't null.
+     *
+     * Returns true on success, false on failure.
+     */
+    bool save(const std::string& configPath, const StringSlice& configContents,
+        const std::string& key, const std::vector<Module>& modules,
+        const ReaderEnvironment& environment,
+        std::string* uncachedModule = nullptr) const;
+
+private:
+    enum ActionType {
+        NO_ACTION,
+        MESSAGE_ACTION,
+        DEPENDENCY_ACTION,
+        REMOVE_ACTION,
+        INSTALL_ACTION,
+        SHELL_ACTION,
+        FILE_CHECK_ACTION
+    };
+
+    std::string path;
+
+    /*
+     * Creates the header that the cache must start with to be used for the
+     * config file at configPath.
+     *
+     * Returns true on success, false if the config file couldn't be read.
+     */
+    static bool createHeader(const std::string& configPath,
+        const StringSlice& configContents, const std::string& key,
+        std::string& header);
+
+    static void writeNumber(std::string& output, uint64_t number);
+    static void writeString(std::string& output, const std::string& string);
+    static void writeStrings(
+        std::string& output, const std::vector<std::string>& strings);
+    /* Returns false if one of the actions can't be cached. */
+    static bool writeActions(std::string& output,
+        const std::vector<std::shared_ptr<ModuleAction>>& actions);
+    static bool writeAction(
+        std::string& output, const std::shared_ptr<ModuleAction>& action);
+
+    /*
+     * These read from current, which is moved past whatever was read, and
+     * fail instead of reading past end.
+     *
+     * Returns true on success, false on failure.
+     */
+    static bool readNumber(
+        const char*& current, const char* end, uint64_t& number);
+    static bool readString(
+        const char*& current, const char* end, std::string& string);
+    static bool readStrings(const char*& current, const char* end,
+        std::vector<std::string>& strings);
+    /* The actions read are made in arena, like makeArenaShared(). */
+    static bool readActions(const char*& current, const char* end,
+        const std::shared_ptr<Arena>& arena,
+        std::vector<std::shared_ptr<ModuleAction>>& actions);
+    static bool readAction(const char*& current, const char* end,
+        const std::shared_ptr<Arena>& arena,
+        std::shared_ptr<ModuleAction>& action);
+};
+} /* namespace dfm */
+
+#endif /* MODULE_CACHE_H */
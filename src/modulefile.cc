@@ -89,6 +89,18 @@ ModuleFile::setDestinationFilename(const std::string& destinationFilename)
     this->destinationFilename = destinationFilename;
 }
 
+InstallMode
+ModuleFile::getInstallMode() const
+{
+    return installMode;
+}
+
+void
+ModuleFile::setInstallMode(InstallMode installMode)
+{
+    this->installMode = installMode;
+}
+
 std::string
 ModuleFile::getSourcePath(const std::string& sourceDirectory) const
 {
@@ -107,22 +119,30 @@ ModuleFile::getDestinationPath() const
 std::shared_ptr<InstallAction>
 ModuleFile::createInstallAction(const std::string& sourceDirectory) const
 {
-    return std::shared_ptr<InstallAction>(new InstallAction(
+    std::shared_ptr<InstallAction> action(new InstallAction(
         filename, sourceDirectory, destinationFilename, destinationDirectory));
+    action->setInstallMode(installMode);
+    return action;
 }
 
 std::shared_ptr<RemoveAction>
-ModuleFile::createUninstallAction() const
+ModuleFile::createUninstallAction(const std::string& sourceDirectory) const
 {
-    return std::shared_ptr<RemoveAction>(
+    std::shared_ptr<RemoveAction> action(
         new RemoveAction(getDestinationPath()));
+    /* Only the link that was installed may be removed. */
+    if (installMode != COPY_INSTALL_MODE)
+        action->setLinkSource(getSourcePath(sourceDirectory), installMode);
+    return action;
 }
 
 std::shared_ptr<FileCheckAction>
 ModuleFile::createUpdateAction(const std::string& sourceDirectory) const
 {
-    return std::shared_ptr<FileCheckAction>(new FileCheckAction(
+    std::shared_ptr<FileCheckAction> action(new FileCheckAction(
         getSourcePath(sourceDirectory), getDestinationPath()));
+    action->setInstallMode(installMode);
+    return action;
 }
 
 std::vector<std::string>
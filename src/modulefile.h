@@ -31,6 +31,7 @@
 #include "filecheckaction.h"
 #include "installaction.h"
 #include "removeaction.h"
+#include "util.h"
 
 namespace dfm {
 
@@ -53,6 +54,13 @@ public:
     void setDestinationDirectory(const std::string& destinationDirectory);
     const std::string& getDestinationFilename() const;
     void setDestinationFilename(const std::string& destinationFilename);
+    InstallMode getInstallMode() const;
+    /*
+     * Sets whether the file is copied or linked when it's installed. Linked
+     * files are only updated if the link is wrong, and only removed if it's
+     * still the link that was installed.
+     */
+    void setInstallMode(InstallMode installMode);
     AbstractWindow* getWindow() const;
     void setWindow(AbstractWindow* window);
 
@@ -61,7 +69,8 @@ public:
 
     std::shared_ptr<InstallAction> createInstallAction(
         const std::string& sourceDirectory) const;
-    std::shared_ptr<RemoveAction> createUninstallAction() const;
+    std::shared_ptr<RemoveAction> createUninstallAction(
+        const std::string& sourceDirectory) const;
     std::shared_ptr<FileCheckAction> createUpdateAction(
         const std::string& sourceDirectory) const;
 
@@ -73,6 +82,7 @@ private:
     std::string filename;
     std::string destinationDirectory;
     std::string destinationFilename;
+    InstallMode installMode = COPY_INSTALL_MODE;
     AbstractWindow* window = nullptr;
 };
 } /* namespace dfm */
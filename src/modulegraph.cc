@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "modulegraph.h"
+
+#include <err.h>
+
+#include <algorithm>
+
+namespace dfm {
+
+ModuleGraph::ModuleGraph(
+    const std::vector<Module>& modules, const ModuleIndex& index)
+    : modules(modules), index(index)
+{
+}
+
+bool
+ModuleGraph::build()
+{
+    int moduleCount = modules.size();
+    requirements.assign(moduleCount, std::vector<int>());
+    bool noErrors = true;
+    for (int i = 0; i < moduleCount; i++) {
+        for (const auto& name : modules[i].getRequirements()) {
+            int requirement = index.findModule(name);
+            if (requirement == -1) {
+                warnx("Module \"%s\" requires unknown module \"%s\".",
+                    modules[i].getName().c_str(), name.c_str());
+                noErrors = false;
+            } else
+                requirements[i].push_back(requirement);
+        }
+    }
+    if (!noErrors)
+        return false;
+
+    ranks.assign(moduleCount, -1);
+    std::vector<VisitState> states(moduleCount, UNVISITED_STATE);
+    std::vector<int> path;
+    int nextRank = 0;
+    for (int i = 0; i < moduleCount; i++) {
+        if (!rankModule(i, states, path, nextRank))
+            return false;
+    }
+    return true;
+}
+
+bool
+ModuleGraph::rankModule(int index, std::vector<VisitState>& states,
+    std::vector<int>& path, int& nextRank)
+{
+    if (states[index] == VISITED_STATE)
+        return true;
+    if (states[index] == VISITING_STATE) {
+        std::string cycle;
+        auto start = std::find(path.begin(), path.end(), index);
+        for (auto i = start; i != path.end(); i++)
+            cycle += "\"" + modules[*i].getName() + "\" -> ";
+        cycle += "\"" + modules[index].getName() + "\"";
+        warnx("Modules require each other: %s.", cycle.c_str());
+        return false;
+    }
+    states[index] = VISITING_STATE;
+    path.push_back(index);
+    for (int requirement : requirements[index]) {
+        if (!rankModule(requirement, states, path, nextRank))
+            return false;
+    }
+    path.pop_back();
+    states[index] = VISITED_STATE;
+    ranks[index] = nextRank++;
+    return true;
+}
+
+std::vector<int>
+ModuleGraph::addRequirements(const std::vector<int>& selected) const
+{
+    std::vector<bool> isSelected(modules.size(), false);
+    std::vector<int> unvisited;
+    for (int index : selected) {
+        if (!isSelected[index]) {
+            isSelected[index] = true;
+            unvisited.push_back(index);
+        }
+    }
+    while (!unvisited.empty()) {
+        int index = unvisited.back();
+        unvisited.pop_back();
+        for (int requirement : requirements[index]) {
+            if (!isSelected[requirement]) {
+                isSelected[requirement] = true;
+                unvisited.push_back(requirement);
+            }
+        }
+    }
+    std::vector<int> withRequirements;
+    for (std::vector<bool>::size_type i = 0; i < isSelected.size(); i++) {
+        if (isSelected[i])
+            withRequirements.push_back(i);
+    }
+    return withRequirements;
+}
+
+std::vector<int>
+ModuleGraph::sortModules(const std::vector<int>& selected) const
+{
+    std::vector<int> sorted = selected;
+    std::sort(sorted.begin(), sorted.end(),
+        [this](int first, int second) { return ranks[first] < ranks[second]; });
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    return sorted;
+}
+
+std::vector<std::vector<int>>
+ModuleGraph::findPrerequisites(
+    const std::vector<int>& order, bool reversed) const
+{
+    std::vector<int> positions(modules.size(), -1);
+    for (std::vector<int>::size_type i = 0; i < order.size(); i++)
+        positions[order[i]] = i;
+
+    std::vector<std::vector<int>> prerequisites(order.size());
+    std::vector<int> visitedBy(modules.size(), -1);
+    for (std::vector<int>::size_type i = 0; i < order.size(); i++) {
+        /* Go through modules that aren't in order to the ones that are. */
+        std::vector<int> unvisited(
+            requirements[order[i]].begin(), requirements[order[i]].end());
+        while (!unvisited.empty()) {
+            int requirement = unvisited.back();
+            unvisited.pop_back();
+            if (visitedBy[requirement] == static_cast<int>(i))
+                continue;
+            visitedBy[requirement] = i;
+            if (positions[requirement] == -1)
+                unvisited.insert(unvisited.end(),
+                    requirements[requirement].begin(),
+                    requirements[requirement].end());
+            else if (reversed)
+                prerequisites[positions[requirement]].push_back(i);
+            else
+                prerequisites[i].push_back(positions[requirement]);
+        }
+    }
+    for (auto& modulePrerequisites : prerequisites)
+        std::sort(modulePrerequisites.begin(), modulePrerequisites.end());
+    return prerequisites;
+}
+
+std::vector<int>
+ModuleGraph::findCriticalPath(
+    const std::vector<std::vector<int>>& prerequisites)
+{
+    int moduleCount = prerequisites.size();
+    /* The length of the longest chain ending at each module. */
+    std::vector<int> lengths(moduleCount, 1);
+    std::vector<int> previous(moduleCount, -1);
+    int end = -1;
+    for (int i = 0; i < moduleCount; i++) {
+        for (int prerequisite : prerequisites[i]) {
+            if (lengths[prerequisite] + 1 > lengths[i]) {
+                lengths[i] = lengths[prerequisite] + 1;
+                previous[i] = prerequisite;
+            }
+        }
+        if (end == -1 || lengths[i] > lengths[end])
+            end = i;
+    }
+    std::vector<int> path;
+    for (int i = end; i != -1; i = previous[i])
+        path.push_back(i);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+} /* namespace dfm */
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MODULE_GRAPH_H
+#define MODULE_GRAPH_H
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+#include "module.h"
+#include "moduleindex.h"
+
+namespace dfm {
+
+/*
+ * The modules from a config file along with the modules that each one
+ * requires, which have to be installed before it and uninstalled after it.
+ * Modules are referred to by their index in the list they came from.
+ */
+class ModuleGraph {
+public:
+    /*
+     * The modules and the index of them must outlive the graph, which uses
+     * the index to find required modules.
+     */
+    ModuleGraph(const std::vector<Module>& modules, const ModuleIndex& index);
+
+    /*
+     * Finds the module for every requirement and checks that no modules
+     * require each other, giving a warning for each problem.
+     *
+     * Returns true on success, false on failure.
+     */
+    bool build();
+    /*
+     * Returns selected along with every module that they require, directly or
+     * not, in config order.
+     */
+    std::vector<int> addRequirements(const std::vector<int>& selected) const;
+    /*
+     * Returns selected ordered so that each module comes after the modules it
+     * requires, even through modules that aren't selected, and otherwise in
+     * config order.
+     */
+    std::vector<int> sortModules(const std::vector<int>& selected) const;
+    /*
+     * Returns what each module in order has to wait for as positions in
+     * order, where order must be sorted by sortModules(). A module waits for
+     * the modules it requires, including through modules that aren't in
+     * order. If reversed is true, then order must be sorted and then
+     * reversed, and a module waits for the modules that require it instead.
+     */
+    std::vector<std::vector<int>> findPrerequisites(
+        const std::vector<int>& order, bool reversed) const;
+    /*
+     * Returns the positions of the longest chain of modules that each have to
+     * wait for the one before it, given what each module waits for, which
+     * must only be modules before it. Nothing can finish sooner than this
+     * chain can run one module at a time.
+     */
+    static std::vector<int> findCriticalPath(
+        const std::vector<std::vector<int>>& prerequisites);
+
+private:
+    enum VisitState { UNVISITED_STATE, VISITING_STATE, VISITED_STATE };
+
+    const std::vector<Module>& modules;
+    const ModuleIndex& index;
+    /* The indices of the modules that each module requires. */
+    std::vector<std::vector<int>> requirements;
+    /* The position of each module in a sorted order of every module. */
+    std::vector<int> ranks;
+
+    /*
+     * Visits the module at index and then the modules it requires, which are
+     * given a rank before it. path holds the modules being visited, to name
+     * the modules in a cycle if one is found.
+     *
+     * Returns true if no cycle was found, false otherwise.
+     */
+    bool rankModule(int index, std::vector<VisitState>& states,
+        std::vector<int>& path, int& nextRank);
+};
+} /* namespace dfm */
+
+#endif /* MODULE_GRAPH_H */
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "moduleindex.h"
+
+#include <fnmatch.h>
+
+#include <algorithm>
+
+namespace dfm {
+
+/* The characters that make a name a pattern, as fnmatch() sees them. */
+static const char PATTERN_CHARACTERS[] = "*?[\\";
+
+ModuleIndex::ModuleIndex(const std::vector<Module>& modules)
+    : ModuleIndex(getNames(modules))
+{
+}
+
+ModuleIndex::ModuleIndex(const std::vector<std::string>& names)
+{
+    indices.reserve(names.size());
+    for (std::vector<std::string>::size_type i = 0; i < names.size(); i++) {
+        if (indices.insert(std::make_pair(names[i], i)).second)
+            sortedNames.push_back(std::make_pair(names[i], i));
+    }
+    std::sort(sortedNames.begin(), sortedNames.end());
+}
+
+int
+ModuleIndex::findModule(const std::string& name) const
+{
+    auto position = indices.find(name);
+    return (position != indices.end()) ? position->second : -1;
+}
+
+std::vector<int>
+ModuleIndex::findMatchingModules(const std::string& pattern) const
+{
+    std::vector<int> matches;
+    if (!isPattern(pattern)) {
+        int index = findModule(pattern);
+        if (index != -1)
+            matches.push_back(index);
+        return matches;
+    }
+    /* Only names that start with the part before any wildcard can match. */
+    std::string prefix =
+        pattern.substr(0, pattern.find_first_of(PATTERN_CHARACTERS));
+    auto position = std::lower_bound(sortedNames.begin(), sortedNames.end(),
+        std::make_pair(prefix, -1));
+    for (; position != sortedNames.end()
+         && position->first.compare(0, prefix.size(), prefix) == 0;
+         position++) {
+        if (fnmatch(pattern.c_str(), position->first.c_str(), 0) == 0)
+            matches.push_back(position->second);
+    }
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
+
+std::vector<std::string>
+ModuleIndex::getNames(const std::vector<Module>& modules)
+{
+    std::vector<std::string> names;
+    names.reserve(modules.size());
+    for (const auto& module : modules)
+        names.push_back(module.getName());
+    return names;
+}
+
+bool
+ModuleIndex::isPattern(const std::string& name)
+{
+    return name.find_first_of(PATTERN_CHARACTERS) != std::string::npos;
+}
+} /* namespace dfm */
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MODULE_INDEX_H
+#define MODULE_INDEX_H
+
+#include "config.h"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "module.h"
+
+namespace dfm {
+
+/*
+ * Finds modules by name or by shell wildcard pattern without going through
+ * every module each time. Modules are referred to by their index in the list
+ * they came from. If two modules have the same name, the first one is found.
+ */
+class ModuleIndex {
+public:
+    ModuleIndex(const std::vector<Module>& modules);
+    /* Indexes modules by their names alone, in the same order. */
+    ModuleIndex(const std::vector<std::string>& names);
+
+    /* Returns the index of the module named name, or -1 if there isn't one. */
+    int findModule(const std::string& name) const;
+    /*
+     * Returns the indices of the modules whose names match pattern, like
+     * "vim*", in config order. A name with no wildcard characters in it only
+     * matches itself.
+     */
+    std::vector<int> findMatchingModules(const std::string& pattern) const;
+    /* Returns whether name has any wildcard characters in it. */
+    static bool isPattern(const std::string& name);
+
+private:
+    /* Returns the names of modules in order. */
+    static std::vector<std::string> getNames(const std::vector<Module>& modules);
+
+    std::unordered_map<std::string, int> indices;
+    /* Every name and its index, sorted by name to find names by prefix. */
+    std::vector<std::pair<std::string, int>> sortedNames;
+};
+} /* namespace dfm */
+
+#endif /* MODULE_INDEX_H */
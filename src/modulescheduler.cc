@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "modulescheduler.h"
+
+#include <sys/wait.h>
+
+#include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <utility>
+
+#include "util.h"
+
+namespace dfm {
+
+ModuleScheduler::ModuleScheduler(int jobCount)
+    : jobCount((jobCount > 0) ? jobCount : 1)
+{
+}
+
+int
+ModuleScheduler::addModule(const Module& module)
+{
+    modules.push_back(&module);
+    prerequisites.push_back(std::vector<int>());
+    return modules.size() - 1;
+}
+
+void
+ModuleScheduler::addPrerequisite(int index, int prerequisite)
+{
+    prerequisites[index].push_back(prerequisite);
+}
+
+void
+ModuleScheduler::addPathConflicts(
+    const std::vector<std::vector<std::string>>& destinationPaths)
+{
+    std::vector<std::pair<std::string, int>> paths;
+    for (std::vector<std::string>::size_type i = 0;
+         i < destinationPaths.size(); i++) {
+        for (const auto& path : destinationPaths[i])
+            paths.push_back(std::make_pair(path, i));
+    }
+    for (const auto& overlap : findOverlappingPaths(std::move(paths)))
+        addPrerequisite(overlap.second, overlap.first);
+    for (auto& modulePrerequisites : prerequisites) {
+        std::sort(modulePrerequisites.begin(), modulePrerequisites.end());
+        modulePrerequisites.erase(std::unique(modulePrerequisites.begin(),
+                                      modulePrerequisites.end()),
+            modulePrerequisites.end());
+    }
+}
+
+bool
+ModuleScheduler::run(std::function<bool(const Module&)> operation)
+{
+    int moduleCount = modules.size();
+    states.assign(moduleCount, PENDING_STATE);
+    processes.assign(moduleCount, -1);
+    outputFiles.assign(moduleCount, nullptr);
+    errorFiles.assign(moduleCount, nullptr);
+    runningCount = 0;
+    int nextToPrint = 0;
+    bool noErrors = true;
+
+    for (;;) {
+        for (int i = 0; i < moduleCount && runningCount < jobCount; i++) {
+            if (states[i] != PENDING_STATE)
+                continue;
+            bool ready = true;
+            bool prerequisiteFailed = false;
+            for (int prerequisite : prerequisites[i]) {
+                if (states[prerequisite] == FAILED_STATE
+                    || states[prerequisite] == SKIPPED_STATE)
+                    prerequisiteFailed = true;
+                else if (states[prerequisite] != SUCCEEDED_STATE)
+                    ready = false;
+            }
+            if (prerequisiteFailed)
+                states[i] = SKIPPED_STATE;
+            else if (ready && !start(i, operation))
+                states[i] = FAILED_STATE;
+        }
+
+        while (nextToPrint < moduleCount
+            && states[nextToPrint] != PENDING_STATE
+            && states[nextToPrint] != RUNNING_STATE) {
+            const std::string& name = modules[nextToPrint]->getName();
+            if (outputFiles[nextToPrint] != nullptr) {
+                printSavedOutput(outputFiles[nextToPrint], stdout);
+                outputFiles[nextToPrint] = nullptr;
+            }
+            if (errorFiles[nextToPrint] != nullptr) {
+                printSavedOutput(errorFiles[nextToPrint], stderr);
+                errorFiles[nextToPrint] = nullptr;
+            }
+            if (states[nextToPrint] == FAILED_STATE) {
+                warnx("Module \"%s\" failed.", name.c_str());
+                noErrors = false;
+            } else if (states[nextToPrint] == SKIPPED_STATE) {
+                warnx("Skipping module \"%s\" because a module it waits for failed.",
+                    name.c_str());
+                noErrors = false;
+            }
+            nextToPrint++;
+        }
+
+        if (runningCount == 0)
+            break;
+        waitForModule();
+    }
+    return noErrors;
+}
+
+bool
+ModuleScheduler::start(
+    int index, std::function<bool(const Module&)>& operation)
+{
+    FILE* outputFile = tmpfile();
+    FILE* errorFile = tmpfile();
+    if (outputFile == NULL || errorFile == NULL) {
+        warn("Failed to create output file for module \"%s\"",
+            modules[index]->getName().c_str());
+        if (outputFile != NULL)
+            fclose(outputFile);
+        if (errorFile != NULL)
+            fclose(errorFile);
+        return false;
+    }
+
+    /* Anything still buffered would be printed by the child too. */
+    std::cout.flush();
+    fflush(NULL);
+    pid_t process = fork();
+    if (process == -1) {
+        warn("Failed to create process for module \"%s\"",
+            modules[index]->getName().c_str());
+        fclose(outputFile);
+        fclose(errorFile);
+        return false;
+    }
+    if (process == 0) {
+        dup2(fileno(outputFile), STDOUT_FILENO);
+        dup2(fileno(errorFile), STDERR_FILENO);
+        bool status = false;
+        try {
+            status = operation(*modules[index]);
+        } catch (std::exception& e) {
+            warnx("%s", e.what());
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(NULL);
+        _exit((status) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    processes[index] = process;
+    outputFiles[index] = outputFile;
+    errorFiles[index] = errorFile;
+    states[index] = RUNNING_STATE;
+    runningCount++;
+    return true;
+}
+
+void
+ModuleScheduler::waitForModule()
+{
+    int status = 0;
+    pid_t process = waitpid(-1, &status, 0);
+    while (process == -1 && errno == EINTR)
+        process = waitpid(-1, &status, 0);
+    if (process == -1) {
+        /*
+         * There are no children to wait for even though some should be
+         * running, so there's no way to know how they went.
+         */
+        warn("Failed to wait for modules");
+        for (auto& state : states) {
+            if (state == RUNNING_STATE)
+                state = FAILED_STATE;
+        }
+        runningCount = 0;
+        return;
+    }
+    for (std::vector<pid_t>::size_type i = 0; i < processes.size(); i++) {
+        if (processes[i] == process && states[i] == RUNNING_STATE) {
+            states[i] = (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+                ? SUCCEEDED_STATE
+                : FAILED_STATE;
+            runningCount--;
+            return;
+        }
+    }
+}
+
+void
+ModuleScheduler::printSavedOutput(FILE* file, FILE* stream)
+{
+    rewind(file);
+    char buffer[BUFSIZ];
+    size_t bytesRead = fread(buffer, 1, sizeof(buffer), file);
+    while (bytesRead > 0) {
+        fwrite(buffer, 1, bytesRead, stream);
+        bytesRead = fread(buffer, 1, sizeof(buffer), file);
+    }
+    fflush(stream);
+    fclose(file);
+}
+} /* namespace dfm */
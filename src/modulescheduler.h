@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MODULE_SCHEDULER_H
+#define MODULE_SCHEDULER_H
+
+#include "config.h"
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "module.h"
+
+namespace dfm {
+
+/*
+ * Runs an operation on a list of modules with up to a given number of them
+ * running at the same time.
+ *
+ * Each module is run in its own child process. Actions print straight to
+ * standard output and run shell commands, so giving each module its own
+ * process is the only way to keep their output apart. The output of each
+ * module is saved and printed in the order that the modules were added once
+ * it's finished, so the output is the same no matter how the modules were
+ * scheduled.
+ *
+ * A module can be made to wait for other modules that were added before it,
+ * like when they write to the same files. A module is skipped if anything it
+ * waits for fails, and every other module is still run.
+ */
+class ModuleScheduler {
+public:
+    ModuleScheduler(int jobCount);
+
+    /* Returns the index of the added module. */
+    int addModule(const Module& module);
+    /*
+     * Makes the module at index wait until the module at prerequisite has
+     * finished. The prerequisite must have been added before the module.
+     */
+    void addPrerequisite(int index, int prerequisite);
+    /*
+     * Makes modules wait for earlier modules that operate on the same paths.
+     * Two paths overlap if they are the same or one of them is a directory
+     * that contains the other. destinationPaths must have the destination
+     * paths of every module, in order, already shell expanded.
+     */
+    void addPathConflicts(
+        const std::vector<std::vector<std::string>>& destinationPaths);
+
+    /*
+     * Runs operation on every module and prints their output. Gives a warning
+     * for each module that failed or was skipped.
+     *
+     * Returns true if operation succeeded for every module, false otherwise.
+     */
+    bool run(std::function<bool(const Module&)> operation);
+
+private:
+    enum ModuleState {
+        PENDING_STATE,
+        RUNNING_STATE,
+        SUCCEEDED_STATE,
+        FAILED_STATE,
+        SKIPPED_STATE
+    };
+
+    int jobCount;
+    std::vector<const Module*> modules;
+    std::vector<std::vector<int>> prerequisites;
+    std::vector<ModuleState> states;
+    std::vector<pid_t> processes;
+    /* Where the standard output and error of each module are saved. */
+    std::vector<FILE*> outputFiles;
+    std::vector<FILE*> errorFiles;
+    int runningCount = 0;
+
+    /*
+     * Starts running module index in a new process.
+     *
+     * Returns true if the process was started, false otherwise.
+     */
+    bool start(int index, std::function<bool(const Module&)>& operation);
+    /* Waits for any running module to finish and records how it went. */
+    void waitForModule();
+    /* Prints the saved contents of file to stream and closes it. */
+    static void printSavedOutput(FILE* file, FILE* stream);
+};
+} /* namespace dfm */
+
+#endif /* MODULE_SCHEDULER_H */
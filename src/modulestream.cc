@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "modulestream.h"
+
+#include <err.h>
+
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#include "arena.h"
+
+namespace dfm {
+
+ModuleStream::ModuleStream(ConfigFileReader& reader) : reader(reader)
+{
+    if (!reader.isOpen()) {
+        warnx("Attempting to read from non-open file reader");
+        finished = true;
+        error = true;
+        return;
+    }
+    reader.startParsing();
+    current = reader.file.getData();
+    end = current + reader.file.getSize();
+}
+
+bool
+ModuleStream::next(Module& module)
+{
+    /*
+     * Each module gets its own arena, so that the actions of a module are
+     * freed along with it instead of when the whole file is done. The next
+     * module has at most its header parsed here, which doesn't allocate from
+     * the arena.
+     */
+    if (!finished)
+        reader.environment.setArena(std::make_shared<Arena>());
+    while (finishedModules.empty() && !finished) {
+        auto output = std::back_inserter(finishedModules);
+        if (current < end) {
+            if (!reader.parseLine(current, end, output)) {
+                reader.finishModule(output);
+                fail();
+            }
+            continue;
+        }
+        reader.finishModule(output);
+        if (!reader.verifyNothingPending())
+            fail();
+        finished = true;
+    }
+    /* Nothing that was read after an error is given back. */
+    if (error || finishedModules.empty())
+        return false;
+    module = std::move(finishedModules.front());
+    finishedModules.erase(finishedModules.begin());
+    return true;
+}
+
+bool
+ModuleStream::hasError() const
+{
+    return error;
+}
+
+bool
+ModuleStream::hasReadModule(const std::string& name) const
+{
+    return reader.moduleLines.count(name) > 0;
+}
+
+void
+ModuleStream::fail()
+{
+    reader.errorMessageNoLine(
+        "Failed to read config file %s.", reader.getPath().c_str());
+    finished = true;
+    error = true;
+}
+} /* namespace dfm */
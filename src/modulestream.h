@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef MODULE_STREAM_H
+#define MODULE_STREAM_H
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+#include "configfilereader.h"
+#include "module.h"
+
+namespace dfm {
+
+/*
+ * Reads the modules of a config file one at a time, giving each one back as
+ * soon as the next one starts, so that a module can be operated on before the
+ * rest of the file is parsed. Only the module being read is kept, so a config
+ * file of any size is read in about the same memory.
+ */
+class ModuleStream {
+public:
+    /* The reader has to stay open for as long as the stream is used. */
+    ModuleStream(ConfigFileReader& reader);
+
+    /*
+     * Parses up to the end of the next module and moves it into module.
+     *
+     * Returns true if there was another module, false at the end of the file
+     * or on an error.
+     */
+    bool next(Module& module);
+    /* Returns whether reading stopped because of an error. */
+    bool hasError() const;
+    /* Returns whether the header of a module named name has been read. */
+    bool hasReadModule(const std::string& name) const;
+
+private:
+    ConfigFileReader& reader;
+    /* The start of the next line to parse and the end of the file. */
+    const char* current = nullptr;
+    const char* end = nullptr;
+    /* Modules that have been finished but not given back yet. */
+    std::vector<Module> finishedModules;
+    bool finished = false;
+    bool error = false;
+
+    /* Stops reading and says that the file couldn't be read. */
+    void fail();
+};
+} /* namespace dfm */
+
+#endif /* MODULE_STREAM_H */
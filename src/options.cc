@@ -26,6 +26,7 @@
 
 #include <err.h>
 #include <getopt.h>
+#include <stdlib.h>
 
 #include <iostream>
 
@@ -48,6 +49,14 @@ DfmOptions::DfmOptions()
       generateConfigFileFlag(false),
       dumpConfigFileFlag(false),
       printModulesFlag(false),
+      useCacheFlag(false),
+      useStateFlag(false),
+      pruneFlag(false),
+      freshShellFlag(false),
+      streamFlag(false),
+      shellExpandFlag(false),
+      jobCount(1),
+      syncMode(BATCH_SYNC_MODE),
       hasSourceDirectory(false)
 {
 }
@@ -69,6 +78,14 @@ DfmOptions::loadFromArguments(int argc, char* argv[])
         { "generate-config-file", no_argument, NULL, 'g' },
         { "dump-config-file", no_argument, NULL, 'G' },
         { "print-modules", no_argument, NULL, 'p' },
+        { "config-cache", no_argument, NULL, 'C' },
+        { "state", no_argument, NULL, 'S' },
+        { "prune", no_argument, NULL, 'P' },
+        { "fresh-shell", no_argument, NULL, 'F' },
+        { "stream", no_argument, NULL, 't' },
+        { "shell-expand", no_argument, NULL, 'x' },
+        { "jobs", required_argument, NULL, 'j' },
+        { "sync", required_argument, NULL, 's' },
         { "directory", required_argument, NULL, 'd' }, { 0, 0, 0, 0 } };
 
     int getoptValue = getopt_long_only(
@@ -108,7 +125,7 @@ DfmOptions::loadFromArguments(int argc, char* argv[])
             break;
         case 'd':
             hasSourceDirectory = true;
-            sourceDirectory = shellExpandPath(optarg);
+            sourceDirectory = optarg;
             break;
         case 'p':
             printModulesFlag = true;
@@ -116,6 +133,42 @@ DfmOptions::loadFromArguments(int argc, char* argv[])
         case 'v':
             verboseFlag = true;
             break;
+        case 'C':
+            useCacheFlag = true;
+            break;
+        case 'S':
+            useStateFlag = true;
+            break;
+        case 'P':
+            pruneFlag = true;
+            break;
+        case 'F':
+            freshShellFlag = true;
+            break;
+        case 't':
+            streamFlag = true;
+            break;
+        case 'x':
+            shellExpandFlag = true;
+            break;
+        case 'j': {
+            char* end = nullptr;
+            long jobs = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || jobs < 1 || jobs > 1024) {
+                warnx("Invalid number of jobs: %s.", optarg);
+                usage();
+                return false;
+            }
+            jobCount = jobs;
+            break;
+        }
+        case 's':
+            if (!parseSyncMode(optarg, syncMode)) {
+                warnx("Invalid sync mode: %s.", optarg);
+                usage();
+                return false;
+            }
+            break;
         case '?':
             usage();
             return false;
@@ -132,6 +185,11 @@ DfmOptions::loadFromArguments(int argc, char* argv[])
     }
     for (int i = optind; i < argc; i++)
         remainingArguments.push_back(std::string(argv[i]));
+    /* Wait for --shell-expand, which can come after the directory. */
+    setPathExpansionMode((shellExpandFlag) ? SHELL_PATH_EXPANSION_MODE
+                                           : BUILTIN_PATH_EXPANSION_MODE);
+    if (hasSourceDirectory)
+        sourceDirectory = shellExpandPath(sourceDirectory);
     return true;
 }
 
@@ -172,6 +230,29 @@ DfmOptions::verifyFlagsConsistency() const
         usage();
         return false;
     }
+    /* Prompts from different modules can't be answered at the same time. */
+    if (interactiveFlag && jobCount > 1) {
+        warnx("May not run more than one job in interactive mode.");
+        usage();
+        return false;
+    }
+
+    /*
+     * Modules are done as they're read, so every one of them is done, in the
+     * order they're read, and there is nothing to cache.
+     */
+    if (streamFlag) {
+        if (!allFlag || !(installModulesFlag || updateModulesFlag)) {
+            warnx("May only stream modules when installing or checking all of them.");
+            usage();
+            return false;
+        }
+        if (jobCount > 1 || useCacheFlag) {
+            warnx("May not stream modules with --jobs or --config-cache.");
+            usage();
+            return false;
+        }
+    }
 
     if (generateConfigFileFlag || dumpConfigFileFlag) {
         if (remainingArguments.size() > 0) {
@@ -224,7 +305,7 @@ void
 DfmOptions::usage()
 {
     std::cout
-        << "usage: dfm [-Iv] [-c|-g|-G|-i|-u|-p] [-d directory] [-a|[MODULES]]"
+        << "usage: dfm [-ICFPStvx] [-c|-g|-G|-i|-u|-p] [-j jobs] [-s none|batch|file] [-d directory] [-a|[MODULES]]"
         << std::endl;
 }
 } /* namespace dfm */
@@ -28,10 +28,12 @@
 #include <string>
 #include <vector>
 
+#include "util.h"
+
 namespace dfm {
 
 /* Inital colon gets getopt to return ":" on missing required argument.  */
-const char GETOPT_SHORT_OPTIONS[] = "iuaIcvgGpd:";
+const char GETOPT_SHORT_OPTIONS[] = "iuaIcvgGpCSPFtxj:s:d:";
 
 class DfmOptions {
 public:
@@ -58,6 +60,20 @@ public:
     bool generateConfigFileFlag;
     bool dumpConfigFileFlag;
     bool printModulesFlag;
+    bool useCacheFlag;
+    bool useStateFlag;
+    /* Remove files that aren't in the source when updating. */
+    bool pruneFlag;
+    /* Run each shell command in a new shell instead of a persistent one. */
+    bool freshShellFlag;
+    /* Operate on each module as soon as it's read from the config file. */
+    bool streamFlag;
+    /* Expand paths with wordexp() instead of only "~" and variables. */
+    bool shellExpandFlag;
+    /* The number of modules that may be operated on at the same time. */
+    int jobCount;
+    /* How hard to try to make installed files survive a crash. */
+    SyncMode syncMode;
     std::vector<std::string> remainingArguments;
     bool hasSourceDirectory;
     std::string sourceDirectory;
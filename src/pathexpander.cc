@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "pathexpander.h"
+
+#include <err.h>
+#include <pwd.h>
+#include <stdlib.h>
+/* For compatability with OpenBSD, which doesn't include wordexp.h. */
+#ifdef HAVE_WORDEXP_H
+#include <wordexp.h>
+#endif
+
+#include "util.h"
+
+namespace dfm {
+
+/* Returns whether c can be part of an environment variable name. */
+static bool
+isNameCharacter(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+        || (c >= '0' && c <= '9') || c == '_';
+}
+
+PathExpander::PathExpander(PathExpansionMode mode) : mode(mode)
+{
+}
+
+void
+PathExpander::setMode(PathExpansionMode mode)
+{
+    std::lock_guard<std::mutex> lock(expanderMutex);
+    this->mode = mode;
+    expandedPaths.clear();
+}
+
+PathExpansionMode
+PathExpander::getMode()
+{
+    return static_cast<PathExpansionMode>(mode.load());
+}
+
+std::string
+PathExpander::expand(const std::string& path)
+{
+    /* Most paths have nothing to expand, so don't wait on the lock for them. */
+    if (getMode() == BUILTIN_PATH_EXPANSION_MODE && !needsExpansion(path))
+        return path;
+
+    /*
+     * Neither wordexp() nor getpwnam() are safe to call from more than one
+     * thread at once, so expand the path while holding the lock.
+     */
+    std::lock_guard<std::mutex> lock(expanderMutex);
+    auto expandedPath = expandedPaths.find(path);
+    if (expandedPath != expandedPaths.end())
+        return expandedPath->second;
+    std::string result = (getMode() == SHELL_PATH_EXPANSION_MODE)
+        ? expandWithShell(path)
+        : expandBuiltin(path);
+    expandedPaths.emplace(path, result);
+    return result;
+}
+
+bool
+PathExpander::needsExpansion(const std::string& path)
+{
+    return (!path.empty() && path[0] == '~')
+        || path.find('$') != std::string::npos;
+}
+
+std::string
+PathExpander::expandBuiltin(const std::string& path)
+{
+    std::string result;
+    result.reserve(path.size());
+    size_t position = 0;
+
+    if (!path.empty() && path[0] == '~') {
+        size_t userEnd = path.find('/');
+        if (userEnd == std::string::npos)
+            userEnd = path.size();
+        std::string home;
+        /* Like the shell, leave "~user" alone if there is no such user. */
+        if (findHomeDirectory(path.substr(1, userEnd - 1), home)) {
+            result += home;
+            position = userEnd;
+        }
+    }
+
+    while (position < path.size()) {
+        size_t dollar = path.find('$', position);
+        if (dollar == std::string::npos)
+            dollar = path.size();
+        result.append(path, position, dollar - position);
+        if (dollar == path.size())
+            break;
+
+        size_t nameStart = dollar + 1;
+        size_t nameEnd = nameStart;
+        size_t referenceEnd = nameStart;
+        if (nameStart < path.size() && path[nameStart] == '{') {
+            nameStart++;
+            nameEnd = nameStart;
+            while (nameEnd < path.size() && isNameCharacter(path[nameEnd]))
+                nameEnd++;
+            /* Only a closed reference with a name counts as one. */
+            if (nameEnd < path.size() && path[nameEnd] == '}'
+                && nameEnd > nameStart)
+                referenceEnd = nameEnd + 1;
+            else
+                nameEnd = nameStart;
+        } else if (nameStart < path.size()
+            && !(path[nameStart] >= '0' && path[nameStart] <= '9')) {
+            while (nameEnd < path.size() && isNameCharacter(path[nameEnd]))
+                nameEnd++;
+            referenceEnd = nameEnd;
+        }
+
+        if (nameEnd == nameStart) {
+            result += '$';
+            position = dollar + 1;
+            continue;
+        }
+        /* An unset variable expands to nothing, like in the shell. */
+        const char* value =
+            getenv(path.substr(nameStart, nameEnd - nameStart).c_str());
+        if (value != NULL)
+            result += value;
+        position = referenceEnd;
+    }
+    return result;
+}
+
+std::string
+PathExpander::expandWithShell(const std::string& path)
+{
+#ifdef HAVE_WORDEXP_H
+    wordexp_t expr;
+    if (wordexp(path.c_str(), &expr, 0) != 0)
+        errx(EXIT_FAILURE, "Failed to expand path.");
+    if (expr.we_wordc != 1)
+        errx(EXIT_FAILURE, "Path expanded into multiple words.");
+    std::string expandedPath = expr.we_wordv[0];
+    wordfree(&expr);
+    return expandedPath;
+#else
+    return expandBuiltin(path);
+#endif
+}
+
+bool
+PathExpander::findHomeDirectory(const std::string& user, std::string& home)
+{
+    if (user.empty()) {
+        /* The shell prefers HOME to the password database. */
+        const char* homeVariable = getenv("HOME");
+        home = (homeVariable != NULL) ? homeVariable : getHomeDirectory();
+        return true;
+    }
+    auto userHome = userHomes.find(user);
+    if (userHome == userHomes.end()) {
+        struct passwd* userInfo = getpwnam(user.c_str());
+        if (userInfo == NULL)
+            return false;
+        userHome = userHomes.emplace(user, userInfo->pw_dir).first;
+    }
+    home = userHome->second;
+    return true;
+}
+} /* namespace dfm */
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PATH_EXPANDER_H
+#define PATH_EXPANDER_H
+
+#include "config.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace dfm {
+
+/* How paths in the config file and on the command line are expanded. */
+enum PathExpansionMode {
+    /*
+     * Expands a "~" or "~user" at the start of the path and $name or ${name}
+     * environment variables anywhere in it, and takes everything else
+     * literally.
+     */
+    BUILTIN_PATH_EXPANSION_MODE,
+    /*
+     * Expands the path as a single word with wordexp(), which does
+     * everything the shell would do to it, like command substitution.
+     */
+    SHELL_PATH_EXPANSION_MODE
+};
+
+/*
+ * Expands paths and remembers the result for each one, since the same path
+ * is usually expanded several times over a run. The user's home directory
+ * and the environment aren't expected to change in between. Safe to use from
+ * more than one thread at once.
+ */
+class PathExpander {
+public:
+    PathExpander(PathExpansionMode mode = BUILTIN_PATH_EXPANSION_MODE);
+    PathExpander(const PathExpander&) = delete;
+    PathExpander& operator=(const PathExpander&) = delete;
+
+    /* Sets the mode and forgets the paths expanded in the old one. */
+    void setMode(PathExpansionMode mode);
+    PathExpansionMode getMode();
+    /*
+     * Expands path the way the mode says to. Exits the program if the shell
+     * can't expand it or it expands to more than one word.
+     *
+     * Returns the expanded path.
+     */
+    std::string expand(const std::string& path);
+
+    /*
+     * Returns whether path has a "~" at the start or a "$" in it. A path
+     * without either is the same after the builtin mode expands it.
+     */
+    static bool needsExpansion(const std::string& path);
+
+private:
+    std::mutex expanderMutex;
+    /* The PathExpansionMode, which is read without locking expanderMutex. */
+    std::atomic<int> mode;
+    std::unordered_map<std::string, std::string> expandedPaths;
+    /* The home directories of the users looked up with "~user". */
+    std::unordered_map<std::string, std::string> userHomes;
+
+    /* Returns path expanded by the builtin mode. */
+    std::string expandBuiltin(const std::string& path);
+    /* Returns path expanded by wordexp(). */
+    std::string expandWithShell(const std::string& path);
+    /*
+     * Sets home to the home directory of user, or of the current user if
+     * user is empty.
+     *
+     * Returns true if the user exists, false otherwise.
+     */
+    bool findHomeDirectory(const std::string& user, std::string& home);
+};
+} /* namespace dfm */
+
+#endif /* PATH_EXPANDER_H */
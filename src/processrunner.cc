@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "processrunner.h"
+
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+extern char** environ;
+
+namespace dfm {
+
+/* The descriptor that spawnShell() gives the extra descriptor as. */
+static const int EXTRA_DESCRIPTOR = 3;
+/* How much output is read at once. */
+static const size_t OUTPUT_READ_SIZE = 16384;
+
+pid_t
+spawnShell(const std::string& script, int extraDescriptor,
+    bool newProcessGroup, int& output, int& error)
+{
+    int outputPipe[2];
+    int errorPipe[2];
+    if (pipe2(outputPipe, O_CLOEXEC) != 0)
+        return -1;
+    if (pipe2(errorPipe, O_CLOEXEC) != 0) {
+        close(outputPipe[0]);
+        close(outputPipe[1]);
+        return -1;
+    }
+    /*
+     * Duplicating a descriptor onto itself wouldn't clear close-on-exec, so
+     * move it out of the way first.
+     */
+    int movedDescriptor = -1;
+    if (extraDescriptor == EXTRA_DESCRIPTOR) {
+        movedDescriptor =
+            fcntl(extraDescriptor, F_DUPFD_CLOEXEC, EXTRA_DESCRIPTOR + 1);
+        extraDescriptor = movedDescriptor;
+    }
+
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+    posix_spawn_file_actions_adddup2(
+        &fileActions, outputPipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&fileActions, errorPipe[1], STDERR_FILENO);
+    if (extraDescriptor != -1)
+        posix_spawn_file_actions_adddup2(
+            &fileActions, extraDescriptor, EXTRA_DESCRIPTOR);
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    if (newProcessGroup) {
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attributes, 0);
+    }
+    const char* arguments[] = { "sh", "-c", script.c_str(), NULL };
+    pid_t process = -1;
+    int status = posix_spawn(&process, SHELL_PATH, &fileActions, &attributes,
+        const_cast<char* const*>(arguments), environ);
+    posix_spawn_file_actions_destroy(&fileActions);
+    posix_spawnattr_destroy(&attributes);
+    close(outputPipe[1]);
+    close(errorPipe[1]);
+    if (movedDescriptor != -1)
+        close(movedDescriptor);
+    if (status != 0) {
+        close(outputPipe[0]);
+        close(errorPipe[0]);
+        return -1;
+    }
+    fcntl(outputPipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(errorPipe[0], F_SETFL, O_NONBLOCK);
+    output = outputPipe[0];
+    error = errorPipe[0];
+    return process;
+}
+
+bool
+forwardOutput(int& descriptor, bool isError, const OutputHandler& handler)
+{
+    char buffer[OUTPUT_READ_SIZE];
+    ssize_t count = read(descriptor, buffer, sizeof(buffer));
+    while (count == -1 && errno == EINTR)
+        count = read(descriptor, buffer, sizeof(buffer));
+    if (count > 0) {
+        handler(buffer, count, isError);
+        return true;
+    }
+    if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return false;
+    close(descriptor);
+    descriptor = -1;
+    return false;
+}
+
+bool
+ProcessRunner::Result::succeeded() const
+{
+    return started && exited && exitStatus == 0;
+}
+
+std::string
+ProcessRunner::Result::describe() const
+{
+    if (!started)
+        return "couldn't be started";
+    if (timedOut)
+        return "timed out after " + std::to_string(timeoutSeconds) + " seconds";
+    if (signal != 0)
+        return "was killed by signal " + std::to_string(signal) + " ("
+            + strsignal(signal) + ")";
+    return "exited with status " + std::to_string(exitStatus);
+}
+
+ProcessRunner::ProcessRunner()
+    : handler([](size_t, const char* data, size_t size, bool isError) {
+          fwrite(data, 1, size, (isError) ? stderr : stdout);
+      })
+{
+}
+
+size_t
+ProcessRunner::addCommand(
+    const std::string& command, unsigned int timeoutSeconds)
+{
+    Process process;
+    process.command = command;
+    process.result.timeoutSeconds = timeoutSeconds;
+    processes.push_back(process);
+    return processes.size() - 1;
+}
+
+void
+ProcessRunner::setOutputHandler(const IndexedOutputHandler& handler)
+{
+    this->handler = handler;
+}
+
+const ProcessRunner::Result&
+ProcessRunner::getResult(size_t index) const
+{
+    return processes[index].result;
+}
+
+bool
+ProcessRunner::reap(Process& process, bool wait)
+{
+    int options = (wait) ? 0 : WNOHANG;
+    int status = 0;
+    pid_t waited = waitpid(process.id, &status, options);
+    while (waited == -1 && errno == EINTR)
+        waited = waitpid(process.id, &status, options);
+    if (waited == 0)
+        return false;
+    if (waited == process.id) {
+        if (WIFEXITED(status)) {
+            process.result.exited = true;
+            process.result.exitStatus = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status))
+            process.result.signal = WTERMSIG(status);
+    }
+    return true;
+}
+
+bool
+ProcessRunner::run()
+{
+    /* Anything buffered has to come out before what the processes write. */
+    fflush(stdout);
+    fflush(stderr);
+    size_t runningCount = 0;
+    for (auto& process : processes) {
+        unsigned int timeoutSeconds = process.result.timeoutSeconds;
+        /* Only a process with a timeout needs a group of its own to kill. */
+        process.id = spawnShell(process.command, -1, timeoutSeconds > 0,
+            process.output, process.error);
+        if (process.id == -1)
+            continue;
+        process.result.started = true;
+        if (timeoutSeconds > 0) {
+            process.hasDeadline = true;
+            process.deadline = std::chrono::steady_clock::now()
+                + std::chrono::seconds(timeoutSeconds);
+        }
+        runningCount++;
+    }
+
+    std::vector<struct pollfd> descriptors;
+    /* The process and whether it's standard error for each descriptor. */
+    std::vector<std::pair<size_t, bool>> owners;
+    while (runningCount > 0) {
+        descriptors.clear();
+        owners.clear();
+        int timeout = -1;
+        bool hasDeadline = false;
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < processes.size(); i++) {
+            Process& process = processes[i];
+            if (process.id == -1)
+                continue;
+            if (process.output != -1) {
+                descriptors.push_back({ process.output, POLLIN, 0 });
+                owners.push_back(std::make_pair(i, false));
+            }
+            if (process.error != -1) {
+                descriptors.push_back({ process.error, POLLIN, 0 });
+                owners.push_back(std::make_pair(i, true));
+            }
+            /*
+             * Once its output is closed, a process is about to exit, but
+             * there's no descriptor to wait on for that.
+             */
+            int wait = (process.output == -1 && process.error == -1)
+                ? 1
+                : PROCESS_CHECK_MILLISECONDS;
+            if (process.hasDeadline && !process.result.timedOut) {
+                hasDeadline = true;
+                auto remaining =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        process.deadline - now)
+                        .count();
+                wait = std::min<long long>(
+                    wait, std::max<long long>(remaining + 1, 0));
+            }
+            timeout = (timeout == -1) ? wait : std::min(timeout, wait);
+        }
+        /*
+         * With no output left to pass on and nothing to kill, there's only
+         * waiting for the processes to exit.
+         */
+        bool waitForExit = descriptors.empty() && !hasDeadline;
+        if (!waitForExit
+            && poll(descriptors.data(), descriptors.size(), timeout) > 0) {
+            for (size_t i = 0; i < descriptors.size(); i++) {
+                if (descriptors[i].revents == 0)
+                    continue;
+                size_t index = owners[i].first;
+                bool isError = owners[i].second;
+                Process& process = processes[index];
+                forwardOutput((isError) ? process.error : process.output,
+                    isError, [this, index](const char* data, size_t size,
+                                 bool isError) {
+                        handler(index, data, size, isError);
+                    });
+            }
+        }
+
+        now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < processes.size(); i++) {
+            Process& process = processes[i];
+            if (process.id == -1)
+                continue;
+            if (process.hasDeadline && !process.result.timedOut
+                && now >= process.deadline) {
+                kill(-process.id, SIGKILL);
+                process.result.timedOut = true;
+            }
+            if (!reap(process, waitForExit))
+                continue;
+            /*
+             * Something it started in the background could still have its
+             * output open, so only take what's already there.
+             */
+            OutputHandler indexedHandler = [this, i](const char* data,
+                                               size_t size, bool isError) {
+                handler(i, data, size, isError);
+            };
+            while (process.output != -1
+                && forwardOutput(process.output, false, indexedHandler))
+                ;
+            while (process.error != -1
+                && forwardOutput(process.error, true, indexedHandler))
+                ;
+            if (process.output != -1)
+                close(process.output);
+            if (process.error != -1)
+                close(process.error);
+            process.output = -1;
+            process.error = -1;
+            process.id = -1;
+            runningCount--;
+        }
+    }
+
+    bool succeeded = true;
+    for (const auto& process : processes) {
+        if (!process.result.succeeded())
+            succeeded = false;
+    }
+    return succeeded;
+}
+} /* namespace dfm */
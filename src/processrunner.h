@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef PROCESS_RUNNER_H
+#define PROCESS_RUNNER_H
+
+#include "config.h"
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace dfm {
+
+/* The shell that runs shell commands, the same one system() uses. */
+const char SHELL_PATH[] = "/bin/sh";
+/*
+ * The longest that the runner waits without checking whether its processes
+ * have exited, in case something they started is still holding their output
+ * open.
+ */
+const int PROCESS_CHECK_MILLISECONDS = 100;
+
+/*
+ * Receives output from a process as soon as it's read, where isError is true
+ * if it was written to standard error.
+ */
+typedef std::function<void(const char* data, size_t size, bool isError)>
+    OutputHandler;
+
+/*
+ * Starts SHELL_PATH running script with its standard output and standard error
+ * going to new pipes, and sets output and error to the ends to read from,
+ * which don't block. Standard input is shared. If extraDescriptor isn't -1,
+ * then the shell also gets it as descriptor 3. If newProcessGroup is true,
+ * then the shell leads a new process group, so that it and everything it
+ * starts can be killed at once.
+ *
+ * Returns the process ID of the shell, or -1 on failure.
+ */
+pid_t spawnShell(const std::string& script, int extraDescriptor,
+    bool newProcessGroup, int& output, int& error);
+/*
+ * Reads what's available from descriptor, up to a limit, and gives it to
+ * handler. If the end of it was reached, then closes it and sets it to -1.
+ *
+ * Returns true if anything was read, false otherwise.
+ */
+bool forwardOutput(int& descriptor, bool isError, const OutputHandler& handler);
+
+/*
+ * Runs shell commands as separate processes, all at the same time, and waits
+ * for them while passing on their output as it arrives. Each command can have
+ * a timeout, after which it's killed along with anything it started.
+ */
+class ProcessRunner {
+public:
+    struct Result {
+        /* Whether the process could be started. */
+        bool started = false;
+        /* Whether it exited normally, which sets exitStatus. */
+        bool exited = false;
+        int exitStatus = 0;
+        /* The signal that killed it, or 0 if none did. */
+        int signal = 0;
+        bool timedOut = false;
+        unsigned int timeoutSeconds = 0;
+
+        /* Returns whether it ran and exited with a status of 0. */
+        bool succeeded() const;
+        /* Returns what happened to it, like "exited with status 3". */
+        std::string describe() const;
+    };
+
+    /*
+     * Receives output from the command at index, otherwise the same as
+     * OutputHandler.
+     */
+    typedef std::function<void(
+        size_t index, const char* data, size_t size, bool isError)>
+        IndexedOutputHandler;
+
+    ProcessRunner();
+
+    /*
+     * Adds command to be run by SHELL_PATH, which is killed if it runs for
+     * longer than timeoutSeconds unless that's 0.
+     *
+     * Returns the index of the command.
+     */
+    size_t addCommand(const std::string& command, unsigned int timeoutSeconds);
+    /*
+     * Sets what's done with the output of the commands. By default, it's
+     * written to standard output and standard error.
+     */
+    void setOutputHandler(const IndexedOutputHandler& handler);
+    /*
+     * Starts every command and waits for all of them to finish.
+     *
+     * Returns true if every command succeeded, false otherwise.
+     */
+    bool run();
+    /* Returns what happened to the command at index after run(). */
+    const Result& getResult(size_t index) const;
+
+private:
+    struct Process {
+        std::string command;
+        pid_t id = -1;
+        int output = -1;
+        int error = -1;
+        bool hasDeadline = false;
+        std::chrono::steady_clock::time_point deadline;
+        Result result;
+    };
+
+    std::vector<Process> processes;
+    IndexedOutputHandler handler;
+
+    /*
+     * Checks whether the process has exited, waiting for it to if wait is
+     * true, and records how it exited if it has.
+     *
+     * Returns true if it's exited, false otherwise.
+     */
+    static bool reap(Process& process, bool wait);
+};
+} /* namespace dfm */
+
+#endif /* PROCESS_RUNNER_H */
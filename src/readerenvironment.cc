@@ -24,6 +24,8 @@
 
 #include "readerenvironment.h"
 
+#include <utility>
+
 #include "util.h"
 
 namespace dfm {
@@ -64,6 +66,18 @@ ReaderEnvironment::setDirectory(const std::string& directory)
     this->directory = directory;
 }
 
+const std::shared_ptr<Arena>&
+ReaderEnvironment::getArena() const
+{
+    return arena;
+}
+
+void
+ReaderEnvironment::setArena(std::shared_ptr<Arena> arena)
+{
+    this->arena = std::move(arena);
+}
+
 void
 ReaderEnvironment::setVariable(
     const std::string& name, const std::string& value)
@@ -100,4 +114,17 @@ ReaderEnvironment::accessVariable(const std::string& name, std::string& value)
     } else
         return false;
 }
+
+const std::string*
+ReaderEnvironment::findVariable(const std::string& name) const
+{
+    auto variable = variables.find(name);
+    return (variable != variables.end()) ? &variable->second : nullptr;
+}
+
+const std::unordered_map<std::string, std::string>&
+ReaderEnvironment::getVariables() const
+{
+    return variables;
+}
 } /* namespace dfm */
@@ -25,9 +25,11 @@
 
 #include "config.h"
 
-#include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
+#include "arena.h"
 #include "options.h"
 
 namespace dfm {
@@ -43,6 +45,10 @@ public:
     const std::string& getDirectory() const;
     void setDirectory(const std::string& directory);
 
+    /* Returns where actions are made, or null to make them on the heap. */
+    const std::shared_ptr<Arena>& getArena() const;
+    void setArena(std::shared_ptr<Arena> arena);
+
     /*
      * Sets the variable given by name to value. Overwrites the current value
      * if it exists. Calling hasVariable() after this method will return true.
@@ -82,11 +88,19 @@ public:
      * Returns whether or not the variable given by name is set.
      */
     bool accessVariable(const std::string& name, std::string& value);
+    /*
+     * Returns the value of the variable given by name without copying it, or
+     * null if it isn't set.
+     */
+    const std::string* findVariable(const std::string& name) const;
+    /* Returns every variable that is currently set. */
+    const std::unordered_map<std::string, std::string>& getVariables() const;
 
 private:
     std::shared_ptr<DfmOptions> options;
     std::string directory;
-    std::map<std::string, std::string> variables;
+    std::shared_ptr<Arena> arena;
+    std::unordered_map<std::string, std::string> variables;
 };
 } /* namespace 2016 */
 
@@ -25,13 +25,16 @@
 #include "removeaction.h"
 
 #include <err.h>
+#include <errno.h>
 #include <libgen.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <iostream>
 
 #include "abstractwindow.h"
+#include "installstate.h"
 #include "util.h"
 
 namespace dfm {
@@ -73,6 +76,13 @@ RemoveAction::setFilePath(
     updateName();
 }
 
+void
+RemoveAction::setLinkSource(const std::string& sourcePath, InstallMode mode)
+{
+    linkSourcePath = sourcePath;
+    linkMode = mode;
+}
+
 bool
 RemoveAction::performAction()
 {
@@ -82,8 +92,23 @@ RemoveAction::performAction()
             return true;
         std::cout << std::endl;
     }
+    std::string expandedPath = shellExpandPath(filePath);
+    if (linkMode != COPY_INSTALL_MODE) {
+        std::string sourcePath =
+            getAbsolutePath(shellExpandPath(linkSourcePath));
+        if (!isLinkTo(sourcePath, expandedPath, linkMode)) {
+            verboseMessage("Not removing %s, it isn't a %s to %s.\n\n",
+                filePath.c_str(), getInstallModeName(linkMode),
+                sourcePath.c_str());
+            return true;
+        }
+        verboseMessage("Removing %s.\n\n", filePath.c_str());
+        return unlink(expandedPath.c_str()) == 0 || errno == ENOENT;
+    }
     verboseMessage("Removing %s.\n\n", filePath.c_str());
-    return deleteFile(shellExpandPath(filePath));
+    if (getInstallState() != nullptr)
+        getInstallState()->recordRemoval(expandedPath);
+    return deleteFile(expandedPath);
 }
 
 void
@@ -103,6 +128,14 @@ RemoveAction::createConfigLines() const
     return lines;
 }
 
+std::vector<std::string>
+RemoveAction::getDestinationPaths() const
+{
+    std::vector<std::string> paths;
+    paths.push_back(filePath);
+    return paths;
+}
+
 void
 RemoveAction::graphicalEdit()
 {
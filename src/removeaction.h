@@ -26,6 +26,7 @@
 #include "config.h"
 
 #include "moduleaction.h"
+#include "util.h"
 
 namespace dfm {
 
@@ -40,14 +41,23 @@ public:
     void setFilePath(const std::string& filePath);
     void setFilePath(
         const std::string& filename, const std::string& directory);
+    /*
+     * Makes the action only remove the file if it's still a link to
+     * sourcePath made with mode, and only remove the link itself. Other files
+     * are left alone.
+     */
+    void setLinkSource(const std::string& sourcePath, InstallMode mode);
     bool performAction() override;
 
     void updateName() override;
     std::vector<std::string> createConfigLines() const override;
+    std::vector<std::string> getDestinationPaths() const override;
     void graphicalEdit() override;
 
 private:
     std::string filePath;
+    std::string linkSourcePath;
+    InstallMode linkMode = COPY_INSTALL_MODE;
 };
 } /* namespace dfm */
 
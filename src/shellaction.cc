@@ -30,6 +30,8 @@
 #include <iostream>
 
 #include "abstractwindow.h"
+#include "processrunner.h"
+#include "shellsession.h"
 
 namespace dfm {
 
@@ -55,26 +57,115 @@ ShellAction::setShellCommands(const std::vector<std::string>& shellCommands)
     this->shellCommands = shellCommands;
 }
 
+unsigned int
+ShellAction::getTimeout() const
+{
+    return timeout;
+}
+
+void
+ShellAction::setTimeout(unsigned int timeout)
+{
+    this->timeout = timeout;
+}
+
+bool
+ShellAction::isParallelSafe() const
+{
+    return parallelSafe;
+}
+
+void
+ShellAction::setParallelSafe(bool parallelSafe)
+{
+    this->parallelSafe = parallelSafe;
+}
+
 bool
 ShellAction::performAction()
 {
     if (shellCommands.size() < 1)
         return true;
-    if (isVerbose() && shellCommands.size() > 0) {
-        std::cout << "Executing with shell:";
-        if (shellCommands.size() == 1)
-            std::cout << " \"" << shellCommands[0] << "\"" << std::endl;
-        else {
-            std::cout << std::endl;
-            for (const auto& commandName : shellCommands)
-                std::cout << "\t" << commandName << std::endl;
-        }
+    /*
+     * The persistent shell can't kill just one command, so a command with a
+     * timeout gets a shell of its own.
+     */
+    if (timeout > 0) {
+        std::vector<bool> succeeded;
+        return performActions(std::vector<ShellAction*>(1, this), succeeded);
+    }
+    printCommands();
+    int exitStatus = 0;
+    if (!runShellCommand(createCommand(), exitStatus,
+            [this](const char* data, size_t size, bool isError) {
+                outputMessage(data, size, isError);
+            })) {
+        warningMessage("Failed to run shell command.");
+        return false;
+    }
+    return exitStatus == 0;
+}
+
+bool
+ShellAction::performActions(
+    const std::vector<ShellAction*>& actions, std::vector<bool>& succeeded)
+{
+    ProcessRunner runner;
+    std::vector<ShellAction*> runningActions;
+    succeeded.assign(actions.size(), true);
+    for (auto action : actions) {
+        if (action->shellCommands.size() < 1)
+            continue;
+        action->printCommands();
+        runner.addCommand(action->createCommand(), action->timeout);
+        runningActions.push_back(action);
+    }
+    runner.setOutputHandler([&runningActions](size_t index, const char* data,
+                                size_t size, bool isError) {
+        runningActions[index]->outputMessage(data, size, isError);
+    });
+    if (runner.run())
+        return true;
+
+    size_t index = 0;
+    for (size_t i = 0; i < actions.size(); i++) {
+        if (actions[i]->shellCommands.size() < 1)
+            continue;
+        const ProcessRunner::Result& result = runner.getResult(index++);
+        if (result.succeeded())
+            continue;
+        succeeded[i] = false;
+        /* A command that exits with a status is expected to explain why. */
+        if (!result.exited)
+            actions[i]->warningMessage(
+                "Shell command %s.", result.describe().c_str());
     }
+    return false;
+}
+
+void
+ShellAction::printCommands() const
+{
+    if (!isVerbose())
+        return;
+    std::cout << "Executing with shell:";
+    if (shellCommands.size() == 1)
+        std::cout << " \"" << shellCommands[0] << "\"" << std::endl;
+    else {
+        std::cout << std::endl;
+        for (const auto& commandName : shellCommands)
+            std::cout << "\t" << commandName << std::endl;
+    }
+}
+
+std::string
+ShellAction::createCommand() const
+{
     std::string command = shellCommands[0];
     for (std::vector<std::string>::size_type i = 1; i < shellCommands.size();
          i++)
         command += "; " + shellCommands[i];
-    return system(command.c_str()) == 0;
+    return command;
 }
 
 void
@@ -93,7 +184,10 @@ std::vector<std::string>
 ShellAction::createConfigLines() const
 {
     std::vector<std::string> lines;
-    lines.push_back("sh");
+    /* The timeout goes on a line of its own, and only applies to this. */
+    if (timeout > 0)
+        lines.push_back("timeout " + std::to_string(timeout));
+    lines.push_back((parallelSafe) ? "psh" : "sh");
     for (const auto& command : shellCommands)
         lines.push_back("\t" + command);
     return lines;
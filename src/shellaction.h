@@ -42,8 +42,30 @@ public:
     const std::vector<std::string>& getShellCommands() const;
     void setShellCommands(const std::vector<std::string>& shellCommands);
 
+    /* Returns the seconds the command can run for, or 0 for no limit. */
+    unsigned int getTimeout() const;
+    /*
+     * Sets the seconds the command can run for before it's killed along with
+     * anything it started, or 0 for no limit.
+     */
+    void setTimeout(unsigned int timeout);
+    bool isParallelSafe() const;
+    /*
+     * Sets whether the command can run at the same time as the parallel safe
+     * shell commands next to it.
+     */
+    void setParallelSafe(bool parallelSafe);
+
     bool performAction() override;
     void addCommand(const std::string& command);
+    /*
+     * Performs every action at the same time, each in a shell of its own,
+     * and sets succeeded to whether each one succeeded.
+     *
+     * Returns true if every action succeeded, false otherwise.
+     */
+    static bool performActions(
+        const std::vector<ShellAction*>& actions, std::vector<bool>& succeeded);
 
     void updateName() override;
     std::vector<std::string> createConfigLines() const override;
@@ -51,6 +73,13 @@ public:
 
 private:
     std::vector<std::string> shellCommands;
+    unsigned int timeout = 0;
+    bool parallelSafe = false;
+
+    /* Says what's being run if verbose. */
+    void printCommands() const;
+    /* Returns the commands joined into one line for the shell. */
+    std::string createCommand() const;
 };
 } /* namespace dfm */
 
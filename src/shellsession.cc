@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "shellsession.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace dfm {
+
+/*
+ * The loop the shell runs. It talks to dfm on descriptor 3, which spawnShell()
+ * gives it and the commands themselves don't get.
+ */
+static const char SESSION_SCRIPT[] =
+    "while IFS= read -r dfm_command <&3; do\n"
+    "\t(eval \"$dfm_command\") 3>&-\n"
+    "\techo \"$?\" >&3\n"
+    "done\n";
+/* How much of the exit status line is read at once. */
+static const size_t STATUS_READ_SIZE = 64;
+
+static std::atomic<int> currentShellMode(PERSISTENT_SHELL_MODE);
+
+ShellSession::ShellSession()
+{
+}
+
+ShellSession::~ShellSession()
+{
+    stop();
+}
+
+bool
+ShellSession::start()
+{
+    int descriptors[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, descriptors) != 0)
+        return false;
+    process =
+        spawnShell(SESSION_SCRIPT, descriptors[1], false, output, error);
+    close(descriptors[1]);
+    if (process == -1) {
+        close(descriptors[0]);
+        return false;
+    }
+    connection = descriptors[0];
+    return true;
+}
+
+bool
+ShellSession::run(const std::string& command, int& exitStatus,
+    const OutputHandler& handler)
+{
+    if (command.find('\n') != std::string::npos)
+        return false;
+    if (process == -1 && !start())
+        return false;
+
+    std::string line = command + "\n";
+    std::string::size_type written = 0;
+    while (written < line.size()) {
+        /* A shell that died shouldn't kill dfm with SIGPIPE. */
+        ssize_t count = send(connection, line.data() + written,
+            line.size() - written, MSG_NOSIGNAL);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count == -1) {
+            stop();
+            return false;
+        }
+        written += count;
+    }
+
+    /* The output has to keep moving, or a command could fill a pipe. */
+    std::string status;
+    while (status.empty() || status.back() != '\n') {
+        struct pollfd descriptors[] = { { connection, POLLIN, 0 },
+            { output, POLLIN, 0 }, { error, POLLIN, 0 } };
+        if (poll(descriptors, 3, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            stop();
+            return false;
+        }
+        if (descriptors[1].revents != 0)
+            forwardOutput(output, false, handler);
+        if (descriptors[2].revents != 0)
+            forwardOutput(error, true, handler);
+        if (descriptors[0].revents != 0) {
+            char buffer[STATUS_READ_SIZE];
+            ssize_t count = read(connection, buffer, sizeof(buffer));
+            if (count == -1 && errno == EINTR)
+                continue;
+            if (count <= 0) {
+                stop();
+                return false;
+            }
+            status.append(buffer, count);
+        }
+    }
+    /* The command finished writing before the shell wrote its status. */
+    while (output != -1 && forwardOutput(output, false, handler))
+        ;
+    while (error != -1 && forwardOutput(error, true, handler))
+        ;
+
+    status.pop_back();
+    char* end = nullptr;
+    exitStatus = strtol(status.c_str(), &end, 10);
+    if (status.empty() || *end != '\0') {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void
+ShellSession::stop()
+{
+    if (process == -1)
+        return;
+    /* The shell exits once it reads the end of its input. */
+    close(connection);
+    connection = -1;
+    if (output != -1)
+        close(output);
+    if (error != -1)
+        close(error);
+    output = -1;
+    error = -1;
+    while (waitpid(process, NULL, 0) == -1 && errno == EINTR)
+        ;
+    process = -1;
+}
+
+void
+setShellMode(ShellMode mode)
+{
+    currentShellMode = mode;
+}
+
+ShellMode
+getShellMode()
+{
+    return static_cast<ShellMode>(currentShellMode.load());
+}
+
+/*
+ * Runs command in a shell of its own and sets exitStatus the same way as
+ * ShellSession::run().
+ *
+ * Returns true if it was run, false otherwise.
+ */
+static bool
+runFreshShellCommand(const std::string& command, int& exitStatus,
+    const OutputHandler& handler)
+{
+    ProcessRunner runner;
+    runner.addCommand(command, 0);
+    runner.setOutputHandler(
+        [&handler](size_t, const char* data, size_t size, bool isError) {
+            handler(data, size, isError);
+        });
+    runner.run();
+    const ProcessRunner::Result& result = runner.getResult(0);
+    if (!result.started)
+        return false;
+    if (result.signal != 0)
+        exitStatus = 128 + result.signal;
+    else
+        exitStatus = result.exitStatus;
+    return true;
+}
+
+bool
+runShellCommand(const std::string& command, int& exitStatus,
+    const OutputHandler& handler)
+{
+    if (getShellMode() == FRESH_SHELL_MODE
+        || command.find('\n') != std::string::npos)
+        return runFreshShellCommand(command, exitStatus, handler);
+
+    static std::mutex sessionMutex;
+    static std::unique_ptr<ShellSession> session;
+    static pid_t sessionOwner = -1;
+    std::lock_guard<std::mutex> lock(sessionMutex);
+    /* A forked process can't share its parent's shell. */
+    if (sessionOwner != getpid()) {
+        session.reset(new ShellSession());
+        sessionOwner = getpid();
+    }
+    return session->run(command, exitStatus, handler);
+}
+} /* namespace dfm */
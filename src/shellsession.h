@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef SHELL_SESSION_H
+#define SHELL_SESSION_H
+
+#include "config.h"
+
+#include "processrunner.h"
+
+#include <sys/types.h>
+
+#include <string>
+
+namespace dfm {
+
+/* How shell commands are run. */
+enum ShellMode {
+    /*
+     * Sends each command to one shell that's kept running, which runs it in a
+     * subshell. That saves starting a new shell for every command.
+     */
+    PERSISTENT_SHELL_MODE,
+    /* Starts a new shell for each command, like system(). */
+    FRESH_SHELL_MODE
+};
+
+/*
+ * A shell that's kept running and given commands one at a time over a socket.
+ * It reads each command as a line, runs it in a subshell so that commands
+ * can't change each other's variables or working directory, and writes back
+ * the exit status as a line of its own.
+ *
+ * The shell shares the standard input of the process that started it, so
+ * commands can still read from the terminal, but its output goes through
+ * pipes so that it can be passed on as it arrives.
+ */
+class ShellSession {
+public:
+    ShellSession();
+    ShellSession(const ShellSession&) = delete;
+    ShellSession& operator=(const ShellSession&) = delete;
+    /* Waits for the shell to exit. */
+    ~ShellSession();
+
+    /*
+     * Runs command and sets exitStatus to its exit status, which is 128 plus
+     * the signal number if it was killed by a signal. Starts the shell if it
+     * isn't running. The command can't contain a newline. Its output is given
+     * to handler.
+     *
+     * Returns true if the command was run, even if it failed, and false if
+     * the shell couldn't be used.
+     */
+    bool run(const std::string& command, int& exitStatus,
+        const OutputHandler& handler);
+    /* Tells the shell to exit and waits for it. */
+    void stop();
+
+private:
+    pid_t process = -1;
+    int connection = -1;
+    int output = -1;
+    int error = -1;
+
+    /*
+     * Starts the shell.
+     *
+     * Returns true on success, false on failure.
+     */
+    bool start();
+};
+
+/* Sets how every shell command after this is run. Defaults to persistent. */
+void setShellMode(ShellMode mode);
+/* Returns how shell commands are run. */
+ShellMode getShellMode();
+/*
+ * Runs command with SHELL_PATH the way the shell mode says to and sets
+ * exitStatus like ShellSession::run() does. Every persistent command in a
+ * process goes to the same shell, and a process created with fork() starts
+ * its own. Commands with newlines in them always get a new shell. The output
+ * of the command is given to handler.
+ *
+ * Returns true if the command was run, even if it failed, and false if it
+ * couldn't be.
+ */
+bool runShellCommand(const std::string& command, int& exitStatus,
+    const OutputHandler& handler);
+} /* namespace dfm */
+
+#endif /* SHELL_SESSION_H */
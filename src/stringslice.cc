@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "stringslice.h"
+
+#include <string.h>
+
+namespace dfm {
+
+StringSlice::StringSlice()
+{
+}
+
+StringSlice::StringSlice(const char* data, size_t length)
+    : data(data), length(length)
+{
+}
+
+StringSlice::StringSlice(const std::string& string)
+    : data(string.data()), length(string.length())
+{
+}
+
+const char*
+StringSlice::getData() const
+{
+    return data;
+}
+
+size_t
+StringSlice::getLength() const
+{
+    return length;
+}
+
+bool
+StringSlice::isEmpty() const
+{
+    return length == 0;
+}
+
+char
+StringSlice::operator[](size_t index) const
+{
+    return data[index];
+}
+
+StringSlice
+StringSlice::subslice(size_t start, size_t length) const
+{
+    if (start > this->length)
+        start = this->length;
+    if (length > this->length - start)
+        length = this->length - start;
+    return StringSlice(data + start, length);
+}
+
+StringSlice
+StringSlice::subslice(size_t start) const
+{
+    return subslice(start, length);
+}
+
+std::string
+StringSlice::toString() const
+{
+    return std::string(data, length);
+}
+
+bool
+StringSlice::operator==(const StringSlice& other) const
+{
+    return length == other.length
+        && (length == 0 || memcmp(data, other.data, length) == 0);
+}
+
+bool
+StringSlice::operator!=(const StringSlice& other) const
+{
+    return !(*this == other);
+}
+
+bool
+StringSlice::operator==(const char* string) const
+{
+    return *this == StringSlice(string, strlen(string));
+}
+
+bool
+StringSlice::operator!=(const char* string) const
+{
+    return !(*this == string);
+}
+} /* namespace dfm */
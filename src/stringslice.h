@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef STRING_SLICE_H
+#define STRING_SLICE_H
+
+#include "config.h"
+
+#include <stddef.h>
+
+#include <string>
+
+namespace dfm {
+
+/*
+ * A StringSlice is a view into a string that is owned by someone else, like a
+ * line that is being read from a config file. It's just a pointer and a
+ * length, so copying one doesn't copy any of the characters and the owner of
+ * the characters has to outlive it.
+ */
+class StringSlice {
+public:
+    StringSlice();
+    StringSlice(const char* data, size_t length);
+    StringSlice(const std::string& string);
+
+    const char* getData() const;
+    size_t getLength() const;
+    bool isEmpty() const;
+    char operator[](size_t index) const;
+
+    /*
+     * Returns the slice that starts at start and has at most length
+     * characters. Clamps start to the length of this slice.
+     */
+    StringSlice subslice(size_t start, size_t length) const;
+    /* Returns the slice starting at start and going to the end. */
+    StringSlice subslice(size_t start) const;
+
+    /* Copies the characters into a new string. */
+    std::string toString() const;
+
+    bool operator==(const StringSlice& other) const;
+    bool operator!=(const StringSlice& other) const;
+    bool operator==(const char* string) const;
+    bool operator!=(const char* string) const;
+
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+};
+} /* namespace dfm */
+
+#endif /* STRING_SLICE_H */
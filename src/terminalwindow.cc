@@ -29,9 +29,19 @@
 namespace dfm {
 
 void
-TerminalWindow::message(const std::string& message, MessageType)
+TerminalWindow::message(const std::string& message, MessageType type)
 {
-    std::cout << message << std::endl;
+    switch (type) {
+    case MESSAGE_OUTPUT:
+        std::cout << message << std::flush;
+        break;
+    case MESSAGE_ERROR_OUTPUT:
+        std::cerr << message << std::flush;
+        break;
+    default:
+        std::cout << message << std::endl;
+        break;
+    }
 }
 
 void
@@ -24,23 +24,40 @@
 
 #include "util.h"
 
+#include <sys/ioctl.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
 #include <err.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <libgen.h>
 #include <pwd.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-/* For compatability with OpenBSD, which doesn't include wordexp.h. */
-#ifdef HAVE_WORDEXP_H
-#include <wordexp.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
 #endif
 
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
 
 namespace dfm {
 
+static std::atomic<int> currentSyncMode(BATCH_SYNC_MODE);
+/* Directories with renamed files that syncPendingFiles() needs to sync. */
+static std::mutex pendingDirectoriesMutex;
+static std::set<std::string> pendingDirectories;
+
 bool
 getYesOrNo()
 {
@@ -103,37 +120,43 @@ getCurrentDirectory()
     return directoryString;
 }
 
+/* Returns the expander used by shellExpandPath(), created on first use. */
+static PathExpander&
+getPathExpander()
+{
+    static PathExpander expander;
+    return expander;
+}
+
+void
+setPathExpansionMode(PathExpansionMode mode)
+{
+    getPathExpander().setMode(mode);
+}
+
+PathExpansionMode
+getPathExpansionMode()
+{
+    return getPathExpander().getMode();
+}
+
 std::string
 shellExpandPath(const std::string& path)
 {
-#ifdef HAVE_WORDEXP_H
-    wordexp_t expr;
-    if (wordexp(path.c_str(), &expr, 0) != 0)
-        errx(EXIT_FAILURE, "Failed to expand path.");
-    if (expr.we_wordc != 1)
-        errx(EXIT_FAILURE, "Path expanded into multiple words.");
-    std::string expandedPath = expr.we_wordv[0];
-    wordfree(&expr);
-    return expandedPath;
-#else
-    std::string pathCopy = path;
-    size_t charPosition = pathCopy.find("~");
-    while (charPosition != std::string::npos) {
-        pathCopy.replace(charPosition, 1, getHomeDirectory());
-        charPosition = pathCopy.find("~");
-    }
-    return pathCopy;
-#endif
+    return getPathExpander().expand(path);
 }
 
-std::string
+const std::string&
 getHomeDirectory()
 {
-    struct passwd* userInfo = getpwuid(getuid());
-    if (userInfo == NULL) {
-        err(EXIT_FAILURE, "Failed to get user info.");
-    }
-    return userInfo->pw_dir;
+    /* The user can't change while running, so only look it up once. */
+    static const std::string homeDirectory = []() {
+        struct passwd* userInfo = getpwuid(getuid());
+        if (userInfo == NULL)
+            err(EXIT_FAILURE, "Failed to get user info.");
+        return std::string(userInfo->pw_dir);
+    }();
+    return homeDirectory;
 }
 
 bool
@@ -249,7 +272,10 @@ ensureDirectoriesExist(const std::string& path)
          * values passed to chmod in C, but I think 777 is guaranteed to be all
          * ones.
          */
-        return mkdir(path.c_str(), 0777) == 0;
+        if (mkdir(path.c_str(), 0777) == 0)
+            return true;
+        /* Something else may have made it since it was checked. */
+        return errno == EEXIST && isDirectory(path);
     }
     return S_ISDIR(pathInfo.st_mode);
 }
@@ -266,91 +292,740 @@ ensureParentDirectoriesExist(const std::string& path)
     return directoriesExist;
 }
 
+const char*
+getCopyMethodName(CopyMethod method)
+{
+    switch (method) {
+    case CLONE_COPY_METHOD:
+        return "clone";
+    case COPY_FILE_RANGE_COPY_METHOD:
+        return "copy_file_range";
+    case SENDFILE_COPY_METHOD:
+        return "sendfile";
+    case READ_WRITE_COPY_METHOD:
+        return "read and write";
+    }
+    return "unknown";
+}
+
+/*
+ * Returns whether or not a copy that failed with the given error should be
+ * tried again with a slower method, since it means that the method isn't
+ * supported rather than that the files can't be copied.
+ */
+static bool
+isUnsupportedCopyError(int error)
+{
+    return error == ENOSYS || error == EINVAL || error == EXDEV
+        || error == EOPNOTSUPP || error == ENOTTY || error == EBADF;
+}
+
+/*
+ * Copies the rest of the file open as source to destination from and to their
+ * current offsets using method.
+ *
+ * Returns 1 if it finished, 0 if method isn't supported here, and -1 if the
+ * copy failed.
+ */
+static int
+copyFileData(int source, int destination, CopyMethod method)
+{
+    switch (method) {
+    case CLONE_COPY_METHOD:
+#if defined(HAVE_LINUX_FS_H) && defined(FICLONE)
+        if (ioctl(destination, FICLONE, source) == 0)
+            return 1;
+        return isUnsupportedCopyError(errno) ? 0 : -1;
+#else
+        return 0;
+#endif
+    case COPY_FILE_RANGE_COPY_METHOD:
+#ifdef HAVE_COPY_FILE_RANGE
+        for (;;) {
+            ssize_t bytesCopied = copy_file_range(
+                source, NULL, destination, NULL, FILE_COPY_CHUNK_SIZE, 0);
+            if (bytesCopied == 0)
+                return 1;
+            if (bytesCopied == -1) {
+                if (errno == EINTR)
+                    continue;
+                return isUnsupportedCopyError(errno) ? 0 : -1;
+            }
+        }
+#else
+        return 0;
+#endif
+    case SENDFILE_COPY_METHOD:
+#ifdef HAVE_SYS_SENDFILE_H
+        for (;;) {
+            ssize_t bytesCopied =
+                sendfile(destination, source, NULL, FILE_COPY_CHUNK_SIZE);
+            if (bytesCopied == 0)
+                return 1;
+            if (bytesCopied == -1) {
+                if (errno == EINTR)
+                    continue;
+                return isUnsupportedCopyError(errno) ? 0 : -1;
+            }
+        }
+#else
+        return 0;
+#endif
+    case READ_WRITE_COPY_METHOD:
+        break;
+    }
+
+    std::unique_ptr<char[]> buffer(new char[FILE_READ_SIZE]);
+    for (;;) {
+        ssize_t bytesRead = read(source, buffer.get(), FILE_READ_SIZE);
+        if (bytesRead == 0)
+            return 1;
+        if (bytesRead == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        ssize_t bytesWritten = 0;
+        while (bytesWritten < bytesRead) {
+            ssize_t result = write(destination, buffer.get() + bytesWritten,
+                bytesRead - bytesWritten);
+            if (result == -1) {
+                if (errno == EINTR)
+                    continue;
+                return -1;
+            }
+            bytesWritten += result;
+        }
+    }
+}
+
+void
+setSyncMode(SyncMode mode)
+{
+    currentSyncMode = mode;
+}
+
+SyncMode
+getSyncMode()
+{
+    return static_cast<SyncMode>(currentSyncMode.load());
+}
+
 bool
-copyRegularFile(
-    const std::string& sourcePath, const std::string& destinationPath)
+parseSyncMode(const std::string& name, SyncMode& mode)
 {
-    std::ifstream reader(sourcePath, std::ios::binary);
-    if (!reader.is_open())
+    if (name == "none")
+        mode = NO_SYNC_MODE;
+    else if (name == "batch")
+        mode = BATCH_SYNC_MODE;
+    else if (name == "file")
+        mode = FILE_SYNC_MODE;
+    else
         return false;
-    reader.seekg(0, std::ios::end);
+    return true;
+}
+
+/*
+ * Makes sure the data written to the open file at descriptor will be written
+ * to disk in the way that the sync mode asks for.
+ *
+ * Returns true on success, false on failure.
+ */
+static bool
+syncWrittenFile(int descriptor)
+{
+    switch (getSyncMode()) {
+    case FILE_SYNC_MODE:
+        return fsync(descriptor) == 0;
+    case BATCH_SYNC_MODE:
+#ifdef HAVE_SYNC_FILE_RANGE
+        /* Only starts writing, syncPendingFiles() waits for it to finish. */
+        sync_file_range(descriptor, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+        return true;
+    case NO_SYNC_MODE:
+        break;
+    }
+    return true;
+}
+
+/*
+ * Makes sure a file renamed into the given directory stays renamed in the way
+ * that the sync mode asks for.
+ *
+ * Returns true on success, false on failure.
+ */
+static bool
+syncDirectory(const std::string& path)
+{
+    switch (getSyncMode()) {
+    case FILE_SYNC_MODE: {
+        int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor == -1)
+            return false;
+        bool synced = fsync(descriptor) == 0;
+        close(descriptor);
+        return synced;
+    }
+    case BATCH_SYNC_MODE: {
+        std::lock_guard<std::mutex> lock(pendingDirectoriesMutex);
+        pendingDirectories.insert(path);
+        return true;
+    }
+    case NO_SYNC_MODE:
+        break;
+    }
+    return true;
+}
+
+bool
+syncPendingFiles()
+{
+    std::set<std::string> directories;
+    {
+        std::lock_guard<std::mutex> lock(pendingDirectoriesMutex);
+        directories.swap(pendingDirectories);
+    }
+    if (directories.empty())
+        return true;
+#ifdef HAVE_SYNCFS
+    /* Syncing a filesystem waits on every file in it, so once is enough. */
+    bool noErrors = true;
+    std::set<dev_t> syncedDevices;
+    for (const auto& directory : directories) {
+        int descriptor = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor == -1) {
+            /* It doesn't matter if the directory was removed since. */
+            if (errno != ENOENT)
+                noErrors = false;
+            continue;
+        }
+        struct stat directoryInfo;
+        if (fstat(descriptor, &directoryInfo) != 0)
+            noErrors = false;
+        else if (syncedDevices.insert(directoryInfo.st_dev).second
+            && syncfs(descriptor) != 0)
+            noErrors = false;
+        close(descriptor);
+    }
+    return noErrors;
+#else
+    sync();
+    return true;
+#endif
+}
+
+/* Returns the directory that path is in. */
+static std::string
+getParentPath(const std::string& path)
+{
+    char* pathCopy = strdup(path.c_str());
+    if (pathCopy == NULL)
+        err(EXIT_FAILURE, NULL);
+    std::string parentPath = dirname(pathCopy);
+    free(pathCopy);
+    return parentPath;
+}
+
+/* Returns the last component of path. */
+static std::string
+getBaseName(const std::string& path)
+{
+    char* pathCopy = strdup(path.c_str());
+    if (pathCopy == NULL)
+        err(EXIT_FAILURE, NULL);
+    std::string baseName = basename(pathCopy);
+    free(pathCopy);
+    return baseName;
+}
+
+/*
+ * Returns the path that writing to path should replace. That's the file that a
+ * symlink points to so that the symlink itself stays, or path otherwise.
+ */
+static std::string
+getReplacedPath(const std::string& path)
+{
+    struct stat pathInfo;
+    if (lstat(path.c_str(), &pathInfo) != 0 || !S_ISLNK(pathInfo.st_mode))
+        return path;
+    char* realPath = realpath(path.c_str(), NULL);
+    if (realPath == NULL)
+        return path;
+    std::string asString(realPath);
+    free(realPath);
+    return asString;
+}
+
+/*
+ * Returns the start of the name of a temporary file next to path, which just
+ * needs a unique number added to the end.
+ */
+static std::string
+getTemporaryPathPrefix(const std::string& path)
+{
+    return getParentPath(path) + "/." + getBaseName(path) + ".dfm-"
+        + std::to_string(getpid()) + "-";
+}
+
+/* Counts up to give every temporary path in this process a different name. */
+static std::atomic<unsigned long> temporaryCount(0);
+
+std::string
+createTemporaryPath(const std::string& path, bool isDirectory, int& descriptor)
+{
+    std::string prefix = getTemporaryPathPrefix(path);
+    for (int i = 0; i < MAX_TEMPORARY_PATH_ATTEMPTS; i++) {
+        std::string temporaryPath = prefix + std::to_string(temporaryCount++);
+        /* Creating them like this gets the user's umask applied. */
+        if (isDirectory) {
+            if (mkdir(temporaryPath.c_str(), 0777) == 0)
+                return temporaryPath;
+        } else {
+            descriptor = open(temporaryPath.c_str(),
+                O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+            if (descriptor != -1)
+                return temporaryPath;
+        }
+        if (errno != EEXIST)
+            return "";
+    }
+    return "";
+}
+
+/* Helper for removeTree, passed to nftw. */
+static int
+removeTreeHelper(
+    const char* fpath, const struct stat*, int typeflag, struct FTW*)
+{
+    if (typeflag == FTW_DP)
+        return rmdir(fpath);
+    return unlink(fpath);
+}
+
+bool
+removeTree(const std::string& path)
+{
+    return nftw(path.c_str(), removeTreeHelper, MAX_FILE_DESCRIPTORS,
+               FTW_DEPTH | FTW_PHYS)
+        == 0;
+}
+
+/*
+ * Copies all of the open file source to the open file destination, starting
+ * with fastestMethod.
+ *
+ * Returns true on success, false on failure.
+ */
+static bool
+copyOpenFile(int source, int destination, CopyMethod fastestMethod,
+    CopyMethod* usedMethod)
+{
     /*
-     * TBH I have no idea what type I'm supposed to be using here. The tellg()
-     * function returns an std::streampos and I'm not sure at all how that
-     * interacts with a streamsize, which is supposed to be the standard for
-     * representing IO stuff in C++ I think. This compiles so whatever.
+     * Every method copies from the current offsets and moves them along, so a
+     * method that stops being supported partway through can be picked up by
+     * the next one.
      */
-    std::streamsize sourceSize = reader.tellg();
-    reader.seekg(0, std::ios::beg);
-    if (!ensureParentDirectoriesExist(destinationPath))
+    int status = 0;
+    int method = fastestMethod;
+    for (; status == 0 && method <= READ_WRITE_COPY_METHOD; method++)
+        status = copyFileData(source, destination, (CopyMethod) method);
+    if (status != 1)
         return false;
-    std::ofstream writer(destinationPath, std::ios::binary);
-    if (!writer.is_open()) {
-        reader.close();
+    if (usedMethod != nullptr)
+        *usedMethod = (CopyMethod)(method - 1);
+    return true;
+}
+
+/*
+ * Copies sourcePath by writing over destinationPath directly, which is only
+ * safe to do when nothing else is looking at it. The copy gets the same
+ * permissions as sourcePath, so checking it for updates afterwards doesn't
+ * find a difference.
+ *
+ * Returns true on success, false on failure.
+ */
+static bool
+copyRegularFileInPlace(const std::string& sourcePath,
+    const std::string& destinationPath, CopyMethod fastestMethod,
+    CopyMethod* usedMethod)
+{
+    int source = open(sourcePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source == -1)
+        return false;
+    struct stat sourceInfo;
+    if (fstat(source, &sourceInfo) != 0) {
+        close(source);
         return false;
     }
-    char readBuffer[FILE_READ_SIZE];
-    std::streamsize remainingBytes = sourceSize;
-    /*
-     * Another thing I'm not sure of is error checking. There are members of
-     * the stream classes that give this stuff, but it's way different than C
-     * IO operations where they return an error code or the number of bytes
-     * read or written, and I don't want to research this.
-     */
-    while (remainingBytes > 0) {
-        std::streamsize bytesToRead = (remainingBytes < FILE_READ_SIZE)
-            ? remainingBytes
-            : FILE_READ_SIZE;
-        reader.read(readBuffer, bytesToRead);
-        writer.write(readBuffer, bytesToRead);
-        remainingBytes -= bytesToRead;
-    }
-    reader.close();
-    writer.close();
-    return true;
+    int destination = open(destinationPath.c_str(),
+        O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (destination == -1) {
+        close(source);
+        return false;
+    }
+    bool copied = fchmod(destination, sourceInfo.st_mode & 07777) == 0
+        && copyOpenFile(source, destination, fastestMethod, usedMethod)
+        && syncWrittenFile(destination);
+    close(source);
+    if (close(destination) != 0)
+        copied = false;
+    return copied;
 }
 
-bool
-copyDirectory(
-    const std::string& sourcePath, const std::string& destinationPath)
+/*
+ * Same as copyRegularFileInPlace() but for a directory and everything in it.
+ *
+ * Returns true on success, false on failure.
+ */
+static bool
+copyDirectoryInPlace(const std::string& sourcePath,
+    const std::string& destinationPath, CopyMethod fastestMethod,
+    CopyMethod* usedMethod)
 {
+    struct stat sourceInfo;
+    if (stat(sourcePath.c_str(), &sourceInfo) != 0)
+        return false;
     struct dirent** entries = nullptr;
     int entryCount =
         scandir(sourcePath.c_str(), &entries, returnOne, alphasort);
     if (entryCount == -1)
         return false;
-    if (!ensureDirectoriesExist(destinationPath)) {
+    /*
+     * It could already be there and read only, and it gets the permissions of
+     * the source at the end.
+     */
+    if (!ensureDirectoriesExist(destinationPath)
+        || chmod(destinationPath.c_str(), S_IRWXU) != 0) {
         free(entries);
         return false;
     }
-    for (int i = 0; i < entryCount; i++) {
+    CopyMethod slowestMethod = fastestMethod;
+    bool copied = true;
+    for (int i = 0; i < entryCount && copied; i++) {
         std::string entryName = entries[i]->d_name;
         if (entryName == "." || entryName == "..")
             continue;
         std::string sourceEntryPath = sourcePath + "/" + entryName;
         std::string destinationEntryPath = destinationPath + "/" + entryName;
-        if (!copyFile(sourceEntryPath, destinationEntryPath)) {
-            free(entries);
+        CopyMethod entryMethod = fastestMethod;
+        struct stat entryInfo;
+        struct stat existingInfo;
+        if (stat(sourceEntryPath.c_str(), &entryInfo) != 0)
+            copied = false;
+        /*
+         * Whatever is already there may be linked to a file that's still in
+         * use, so it's replaced instead of written over. Only directories are
+         * merged.
+         */
+        else if (lstat(destinationEntryPath.c_str(), &existingInfo) == 0
+            && !(S_ISDIR(existingInfo.st_mode) && S_ISDIR(entryInfo.st_mode))
+            && !removeTree(destinationEntryPath))
+            copied = false;
+        else if (S_ISREG(entryInfo.st_mode))
+            copied = copyRegularFileInPlace(sourceEntryPath,
+                destinationEntryPath, fastestMethod, &entryMethod);
+        else if (S_ISDIR(entryInfo.st_mode))
+            copied = copyDirectoryInPlace(sourceEntryPath,
+                destinationEntryPath, fastestMethod, &entryMethod);
+        else
+            copied = false;
+        slowestMethod = std::max(slowestMethod, entryMethod);
+    }
+    for (int i = 0; i < entryCount; i++)
+        free(entries[i]);
+    free(entries);
+    if (copied && usedMethod != nullptr)
+        *usedMethod = slowestMethod;
+    /* This is last in case the directory is supposed to be read only. */
+    return copied
+        && chmod(destinationPath.c_str(), sourceInfo.st_mode & 07777) == 0
+        && syncDirectory(destinationPath);
+}
+
+/*
+ * Fills the empty directory at destinationPath with hard links to everything
+ * in the directory at sourcePath, making new directories to match the ones in
+ * it. Symlinks are linked to and not followed.
+ *
+ * Returns true on success, false on failure.
+ */
+static bool
+linkDirectoryContents(
+    const std::string& sourcePath, const std::string& destinationPath)
+{
+    struct dirent** entries = nullptr;
+    int entryCount =
+        scandir(sourcePath.c_str(), &entries, returnOne, alphasort);
+    if (entryCount == -1)
+        return false;
+    bool linked = true;
+    for (int i = 0; i < entryCount && linked; i++) {
+        std::string entryName = entries[i]->d_name;
+        if (entryName == "." || entryName == "..")
+            continue;
+        std::string sourceEntryPath = sourcePath + "/" + entryName;
+        std::string destinationEntryPath = destinationPath + "/" + entryName;
+        struct stat entryInfo;
+        if (lstat(sourceEntryPath.c_str(), &entryInfo) != 0)
+            linked = false;
+        else if (S_ISDIR(entryInfo.st_mode))
+            linked = mkdir(destinationEntryPath.c_str(), 0700) == 0
+                && linkDirectoryContents(sourceEntryPath, destinationEntryPath)
+                && chmod(destinationEntryPath.c_str(),
+                       entryInfo.st_mode & 07777)
+                    == 0;
+        else
+            linked = link(sourceEntryPath.c_str(),
+                         destinationEntryPath.c_str())
+                == 0;
+    }
+    for (int i = 0; i < entryCount; i++)
+        free(entries[i]);
+    free(entries);
+    return linked;
+}
+
+bool
+copyRegularFile(const std::string& sourcePath,
+    const std::string& destinationPath, CopyMethod fastestMethod,
+    CopyMethod* usedMethod)
+{
+    std::string replacedPath = getReplacedPath(destinationPath);
+    int source = open(sourcePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source == -1)
+        return false;
+    if (!ensureParentDirectoriesExist(replacedPath)) {
+        close(source);
+        return false;
+    }
+    int destination = -1;
+    std::string temporaryPath =
+        createTemporaryPath(replacedPath, false, destination);
+    if (temporaryPath.empty()) {
+        close(source);
+        return false;
+    }
+    /* Keep the permissions of the file being replaced. */
+    struct stat replacedInfo;
+    if (stat(replacedPath.c_str(), &replacedInfo) == 0
+        && S_ISREG(replacedInfo.st_mode))
+        fchmod(destination, replacedInfo.st_mode & 07777);
+
+    bool copied =
+        copyOpenFile(source, destination, fastestMethod, usedMethod)
+        && syncWrittenFile(destination);
+    close(source);
+    if (close(destination) != 0)
+        copied = false;
+    /*
+     * Anything reading the file sees either all of the old one or all of the
+     * new one.
+     */
+    if (!copied || rename(temporaryPath.c_str(), replacedPath.c_str()) != 0) {
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+    return syncDirectory(getParentPath(replacedPath));
+}
+
+/*
+ * Puts the directory at stagingPath where replacedPath is, which must already
+ * be a directory. Afterwards, the old directory is at stagingPath.
+ *
+ * Returns true on success, false on failure.
+ */
+static bool
+exchangeDirectories(
+    const std::string& stagingPath, const std::string& replacedPath)
+{
+#if defined(HAVE_RENAMEAT2) && defined(RENAME_EXCHANGE)
+    if (renameat2(AT_FDCWD, stagingPath.c_str(), AT_FDCWD,
+            replacedPath.c_str(), RENAME_EXCHANGE)
+        == 0)
+        return true;
+    if (errno != ENOSYS && errno != EINVAL)
+        return false;
+#endif
+    /*
+     * Without an exchange, there's a moment where nothing is at replacedPath,
+     * but it's still never partly copied.
+     */
+    int unused = -1;
+    std::string oldPath = createTemporaryPath(replacedPath, true, unused);
+    if (oldPath.empty())
+        return false;
+    if (rename(replacedPath.c_str(), oldPath.c_str()) != 0) {
+        rmdir(oldPath.c_str());
+        return false;
+    }
+    if (rename(stagingPath.c_str(), replacedPath.c_str()) != 0) {
+        rename(oldPath.c_str(), replacedPath.c_str());
+        return false;
+    }
+    return rename(oldPath.c_str(), stagingPath.c_str()) == 0;
+}
+
+bool
+copyDirectory(const std::string& sourcePath,
+    const std::string& destinationPath, CopyMethod fastestMethod,
+    CopyMethod* usedMethod)
+{
+    if (!isDirectory(sourcePath))
+        return false;
+    std::string replacedPath = getReplacedPath(destinationPath);
+    struct stat replacedInfo;
+    bool replacedExists = stat(replacedPath.c_str(), &replacedInfo) == 0;
+    if (replacedExists && !S_ISDIR(replacedInfo.st_mode))
+        return false;
+    if (!ensureParentDirectoriesExist(replacedPath))
+        return false;
+
+    /* Build the whole copy next to the destination, then swap it in. */
+    int unused = -1;
+    std::string stagingPath = createTemporaryPath(replacedPath, true, unused);
+    if (stagingPath.empty())
+        return false;
+    /*
+     * Start from what's already installed so that swapping keeps the files
+     * that aren't in the source, like installing into it file by file would.
+     */
+    if ((replacedExists && !linkDirectoryContents(replacedPath, stagingPath))
+        || !copyDirectoryInPlace(
+            sourcePath, stagingPath, fastestMethod, usedMethod)) {
+        removeTree(stagingPath);
+        return false;
+    }
+    if (!replacedExists) {
+        if (rename(stagingPath.c_str(), replacedPath.c_str()) != 0) {
+            removeTree(stagingPath);
             return false;
         }
+        return syncDirectory(getParentPath(replacedPath));
     }
-    free(entries);
-    return true;
+    chmod(stagingPath.c_str(), replacedInfo.st_mode & 07777);
+    if (!exchangeDirectories(stagingPath, replacedPath)) {
+        removeTree(stagingPath);
+        return false;
+    }
+    /* The staging path now has the old directory in it. */
+    if (!removeTree(stagingPath))
+        warnx("Failed to remove old directory %s.", stagingPath.c_str());
+    return syncDirectory(getParentPath(replacedPath));
 }
 
 bool
-copyFile(const std::string& sourcePath, const std::string& destinationPath)
+copyFile(const std::string& sourcePath, const std::string& destinationPath,
+    CopyMethod fastestMethod, CopyMethod* usedMethod)
 {
     struct stat sourcePathInfo;
     if (stat(sourcePath.c_str(), &sourcePathInfo) != 0)
         return false;
     if (S_ISREG(sourcePathInfo.st_mode))
-        return copyRegularFile(sourcePath, destinationPath);
+        return copyRegularFile(
+            sourcePath, destinationPath, fastestMethod, usedMethod);
     if (S_ISDIR(sourcePathInfo.st_mode))
-        return copyDirectory(sourcePath, destinationPath);
+        return copyDirectory(
+            sourcePath, destinationPath, fastestMethod, usedMethod);
     return false;
 }
 
+const char*
+getInstallModeName(InstallMode mode)
+{
+    switch (mode) {
+    case COPY_INSTALL_MODE:
+        return "copy";
+    case SYMLINK_INSTALL_MODE:
+        return "symlink";
+    case HARDLINK_INSTALL_MODE:
+        return "hard link";
+    }
+    return "unknown";
+}
+
+bool
+linkFile(const std::string& sourcePath, const std::string& destinationPath,
+    InstallMode mode)
+{
+    if (mode == COPY_INSTALL_MODE)
+        return copyFile(sourcePath, destinationPath);
+    if (!ensureParentDirectoriesExist(destinationPath))
+        return false;
+    /* Like a copy, the link is made next to its destination first. */
+    std::string prefix = getTemporaryPathPrefix(destinationPath);
+    std::string temporaryPath;
+    for (int i = 0; i < MAX_TEMPORARY_PATH_ATTEMPTS && temporaryPath.empty();
+         i++) {
+        std::string candidatePath = prefix + std::to_string(temporaryCount++);
+        int status = (mode == SYMLINK_INSTALL_MODE)
+            ? symlink(sourcePath.c_str(), candidatePath.c_str())
+            : link(sourcePath.c_str(), candidatePath.c_str());
+        if (status == 0)
+            temporaryPath = candidatePath;
+        else if (errno != EEXIST)
+            return false;
+    }
+    if (temporaryPath.empty())
+        return false;
+    /*
+     * Unlike a copy, the link replaces whatever is at destinationPath, even a
+     * symlink or a directory.
+     */
+    if (rename(temporaryPath.c_str(), destinationPath.c_str()) != 0) {
+        struct stat destinationInfo;
+        if (lstat(destinationPath.c_str(), &destinationInfo) != 0
+            || !S_ISDIR(destinationInfo.st_mode)
+            || !removeTree(destinationPath)
+            || rename(temporaryPath.c_str(), destinationPath.c_str()) != 0) {
+            unlink(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return syncDirectory(getParentPath(destinationPath));
+}
+
+bool
+isLinkTo(const std::string& sourcePath, const std::string& destinationPath,
+    InstallMode mode)
+{
+    if (mode == SYMLINK_INSTALL_MODE) {
+        struct stat destinationInfo;
+        if (lstat(destinationPath.c_str(), &destinationInfo) != 0
+            || !S_ISLNK(destinationInfo.st_mode))
+            return false;
+        /* The target can't be any longer than the one being looked for. */
+        std::unique_ptr<char[]> target(new char[sourcePath.size() + 1]);
+        ssize_t length = readlink(
+            destinationPath.c_str(), target.get(), sourcePath.size() + 1);
+        return length == static_cast<ssize_t>(sourcePath.size())
+            && sourcePath.compare(0, length, target.get(), length) == 0;
+    }
+    if (mode == HARDLINK_INSTALL_MODE) {
+        struct stat sourceInfo;
+        struct stat destinationInfo;
+        return lstat(sourcePath.c_str(), &sourceInfo) == 0
+            && lstat(destinationPath.c_str(), &destinationInfo) == 0
+            && sourceInfo.st_dev == destinationInfo.st_dev
+            && sourceInfo.st_ino == destinationInfo.st_ino;
+    }
+    return false;
+}
+
+std::string
+getAbsolutePath(const std::string& path)
+{
+    if (!path.empty() && path[0] == '/')
+        return path;
+    std::string::size_type start = 0;
+    while (path.compare(start, 2, "./") == 0)
+        start += 2;
+    std::string currentDirectory = getCurrentDirectory();
+    if (start == path.size() || path.compare(start, std::string::npos, ".") == 0)
+        return currentDirectory;
+    return currentDirectory + "/" + path.substr(start);
+}
+
 int
 returnOne(const struct dirent* entry)
 {
@@ -367,4 +1042,208 @@ getCanonicalPath(const std::string& path)
     free(realPath);
     return asString;
 }
+
+uint64_t
+hashBytes(const char* data, size_t size, uint64_t hash)
+{
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool
+hashFile(const std::string& path, uint64_t& hash)
+{
+    int descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor == -1)
+        return false;
+    std::unique_ptr<char[]> buffer(new char[FILE_READ_SIZE]);
+    uint64_t fileHash = HASH_OFFSET_BASIS;
+    ssize_t bytesRead = readFully(descriptor, buffer.get(), FILE_READ_SIZE);
+    while (bytesRead > 0) {
+        fileHash = hashBytes(buffer.get(), bytesRead, fileHash);
+        bytesRead = readFully(descriptor, buffer.get(), FILE_READ_SIZE);
+    }
+    close(descriptor);
+    if (bytesRead == -1)
+        return false;
+    hash = fileHash;
+    return true;
+}
+
+bool
+haveSameContents(int firstDescriptor, int secondDescriptor)
+{
+    /*
+     * This is called once for every file when comparing directories, so the
+     * buffer is kept around instead of being mapped and unmapped every time.
+     * It's not a vector so that it isn't filled with zeros first.
+     */
+    static thread_local std::unique_ptr<char[]> buffer(
+        new char[2 * FILE_READ_SIZE]);
+    char* firstChunk = buffer.get();
+    char* secondChunk = buffer.get() + FILE_READ_SIZE;
+    for (;;) {
+        ssize_t firstLength =
+            readFully(firstDescriptor, firstChunk, FILE_READ_SIZE);
+        ssize_t secondLength =
+            readFully(secondDescriptor, secondChunk, FILE_READ_SIZE);
+        if (firstLength == -1 || secondLength == -1
+            || firstLength != secondLength
+            || memcmp(firstChunk, secondChunk, firstLength) != 0)
+            return false;
+        if (firstLength == 0)
+            return true;
+    }
+}
+
+ssize_t
+readFully(int descriptor, char* buffer, size_t size)
+{
+    size_t totalRead = 0;
+    while (totalRead < size) {
+        ssize_t bytesRead =
+            read(descriptor, buffer + totalRead, size - totalRead);
+        if (bytesRead == 0)
+            break;
+        if (bytesRead == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        totalRead += bytesRead;
+    }
+    return totalRead;
+}
+
+bool
+pathContains(const std::string& ancestor, const std::string& path)
+{
+    if (path.compare(0, ancestor.length(), ancestor) != 0)
+        return false;
+    return path.length() == ancestor.length() || ancestor == "/"
+        || path[ancestor.length()] == '/';
+}
+
+/*
+ * Orders paths so that every path comes right before everything inside of
+ * it, which is what sorting would do if '/' came before every other
+ * character.
+ */
+static bool
+comparePathsByTree(const std::pair<std::string, int>& first,
+    const std::pair<std::string, int>& second)
+{
+    const std::string& firstPath = first.first;
+    const std::string& secondPath = second.first;
+    std::string::size_type length =
+        std::min(firstPath.length(), secondPath.length());
+    for (std::string::size_type i = 0; i < length; i++) {
+        if (firstPath[i] == secondPath[i])
+            continue;
+        if (firstPath[i] == '/')
+            return true;
+        if (secondPath[i] == '/')
+            return false;
+        return static_cast<unsigned char>(firstPath[i])
+            < static_cast<unsigned char>(secondPath[i]);
+    }
+    if (firstPath.length() != secondPath.length())
+        return firstPath.length() < secondPath.length();
+    return first.second < second.second;
+}
+
+std::vector<std::pair<int, int>>
+findOverlappingPaths(std::vector<std::pair<std::string, int>> paths)
+{
+    for (auto& entry : paths) {
+        std::string& path = entry.first;
+        while (path.length() > 1 && path[path.length() - 1] == '/')
+            path.erase(path.length() - 1);
+    }
+    std::sort(paths.begin(), paths.end(), comparePathsByTree);
+
+    /*
+     * Because of the order, the paths that contain the current one are
+     * always the ones left on the stack after popping everything that
+     * doesn't.
+     */
+    std::vector<std::pair<int, int>> overlaps;
+    std::vector<std::vector<std::string>::size_type> ancestors;
+    for (std::vector<std::string>::size_type i = 0; i < paths.size(); i++) {
+        while (!ancestors.empty()
+            && !pathContains(paths[ancestors.back()].first, paths[i].first))
+            ancestors.pop_back();
+        int index = paths[i].second;
+        for (auto ancestor : ancestors) {
+            int otherIndex = paths[ancestor].second;
+            if (otherIndex < index)
+                overlaps.push_back(std::make_pair(otherIndex, index));
+            else if (index < otherIndex)
+                overlaps.push_back(std::make_pair(index, otherIndex));
+        }
+        ancestors.push_back(i);
+    }
+    return overlaps;
+}
+
+/* Where config warnings on this thread go, or null to give them right away. */
+static thread_local std::vector<ConfigWarning>* collectedConfigWarnings =
+    nullptr;
+
+void
+configWarning(const char* format, ...)
+{
+    va_list argumentList;
+    va_start(argumentList, format);
+    vConfigWarning(format, argumentList);
+    va_end(argumentList);
+}
+
+void
+vConfigWarning(const char* format, va_list argumentList)
+{
+    if (collectedConfigWarnings == nullptr) {
+        vwarnx(format, argumentList);
+        return;
+    }
+    va_list lengthArguments;
+    va_copy(lengthArguments, argumentList);
+    int length = vsnprintf(nullptr, 0, format, lengthArguments);
+    va_end(lengthArguments);
+    if (length < 0)
+        return;
+    std::vector<char> text(length + 1);
+    vsnprintf(text.data(), text.size(), format, argumentList);
+    collectedConfigWarnings->push_back(
+        { std::string(text.data(), length), false });
+}
+
+void
+writeConfigWarning(const std::string& text)
+{
+    if (collectedConfigWarnings == nullptr)
+        std::cerr << text;
+    else
+        collectedConfigWarnings->push_back({ text, true });
+}
+
+void
+collectConfigWarnings(std::vector<ConfigWarning>* warnings)
+{
+    collectedConfigWarnings = warnings;
+}
+
+void
+giveConfigWarnings(const std::vector<ConfigWarning>& warnings)
+{
+    for (const auto& warning : warnings) {
+        if (warning.isRaw)
+            std::cerr << warning.text;
+        else
+            warnx("%s", warning.text.c_str());
+    }
+}
 } /* namespace dfm */
@@ -25,11 +25,20 @@
 
 #include "config.h"
 
+#include <sys/types.h>
+
 #include <dirent.h>
 #include <ftw.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include <iostream>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include "pathexpander.h"
 
 namespace dfm {
 
@@ -39,7 +48,23 @@ namespace dfm {
  */
 const int MAX_FILE_DESCRIPTORS = 30;
 /* The size of the buffer to use when reading from a binary file. */
-const std::streamsize FILE_READ_SIZE = 1024;
+const size_t FILE_READ_SIZE = 131072;
+/* The most bytes to ask the kernel to copy at once. */
+const size_t FILE_COPY_CHUNK_SIZE = 1 << 30;
+/*
+ * The ways that a regular file can be copied, from fastest to slowest. Each
+ * one falls back to the next when the system or filesystem doesn't support it.
+ */
+enum CopyMethod {
+    /* Shares the data of the source file, on filesystems like btrfs and XFS. */
+    CLONE_COPY_METHOD,
+    /* Copies within the kernel, which may also share data. */
+    COPY_FILE_RANGE_COPY_METHOD,
+    /* Copies within the kernel using sendfile. */
+    SENDFILE_COPY_METHOD,
+    /* Reads and writes through a buffer, which works everywhere. */
+    READ_WRITE_COPY_METHOD
+};
 /*
  * Waits for the user to input a yes or no input on the current line. Accepts
  * any string that starts with a "y" or "Y" as true and any string that starts
@@ -71,15 +96,22 @@ bool lineIsYesOrNo(const std::string& input, bool& yesOrNo);
 /* Returns the current working directory. */
 std::string getCurrentDirectory();
 /*
- * Performs shell expansion on the given path. Throws a error if it encounters
- * an errorr or if the string path expands to more than one word.
+ * Sets how every path expanded after this is expanded. Defaults to builtin.
+ */
+void setPathExpansionMode(PathExpansionMode mode);
+/* Returns how paths are expanded. */
+PathExpansionMode getPathExpansionMode();
+/*
+ * Expands "~" and environment variables in the given path the way the path
+ * expansion mode says to, remembering the result for the next time. Exits the
+ * program if the shell can't expand it or it expands to more than one word.
  */
 std::string shellExpandPath(const std::string& path);
 /*
- * Returns the current user's home directory. Throws a runtime error when
- * encountering an error.
+ * Returns the current user's home directory, which is only looked up once.
+ * Exits the program when encountering an error.
  */
-std::string getHomeDirectory();
+const std::string& getHomeDirectory();
 
 /*
  * Determines if the file given by path exists. Exits the program if an error
@@ -131,6 +163,22 @@ bool deleteDirectory(const std::string& path);
  * there was an error removing it.
  */
 bool deleteFile(const std::string& path);
+/*
+ * Removes whatever is at path, and everything in it if it's a directory,
+ * without following any symlinks.
+ *
+ * Returns true on success, false on failure.
+ */
+bool removeTree(const std::string& path);
+/*
+ * Creates a new hidden file or directory next to path with a name that isn't
+ * taken, so that other processes writing the same path don't collide. If it's
+ * a file, then descriptor is set to it open for writing.
+ *
+ * Returns the path that was created, or an empty string on failure.
+ */
+std::string createTemporaryPath(
+    const std::string& path, bool isDirectory, int& descriptor);
 /*
  * Checks to see if the given directory given by path exists and all its parent
  * directories exist. Path must be intended to be a directory. If the file at
@@ -150,33 +198,135 @@ bool ensureDirectoriesExist(const std::string& path);
  * were successfully created, false otherwise.
  */
 bool ensureParentDirectoriesExist(const std::string& path);
+/*
+ * How hard to try to make copied files survive a crash. Files are always
+ * written somewhere else first and then renamed into place, so anything
+ * reading them never sees a partial copy either way.
+ */
+enum SyncMode {
+    /* Leaves writing files to the disk up to the system. */
+    NO_SYNC_MODE,
+    /*
+     * Starts writing each file to the disk right away, and waits for all of
+     * them at once in syncPendingFiles().
+     */
+    BATCH_SYNC_MODE,
+    /* Waits for each file to be on the disk before renaming it into place. */
+    FILE_SYNC_MODE
+};
+/* How many names to try when creating a temporary file. */
+const int MAX_TEMPORARY_PATH_ATTEMPTS = 100;
+
+/* Sets the sync mode used by every copy after this. Defaults to batch. */
+void setSyncMode(SyncMode mode);
+/* Returns the sync mode used by copies. */
+SyncMode getSyncMode();
+/*
+ * Sets mode to the sync mode called name, which is "none", "batch", or
+ * "file".
+ *
+ * Returns true if name is a sync mode, false otherwise.
+ */
+bool parseSyncMode(const std::string& name, SyncMode& mode);
+/*
+ * Waits for every file copied since the last call to be written to the disk.
+ * Does nothing unless the sync mode is batch.
+ *
+ * Returns true on success, false on failure.
+ */
+bool syncPendingFiles();
+/* Returns a short name for method, like "copy_file_range". */
+const char* getCopyMethodName(CopyMethod method);
 /*
  * Copies the given regular file byte for byte. Fails if the source path
  * doesn't exist, the destination path can't be accessed, or if the process
  * failed. Attempts to create parent directories if they don't exist.
  *
+ * The copy is written to a temporary file next to destinationPath and renamed
+ * over it, so the file is never seen partly copied. If destinationPath is a
+ * symlink, then the file it points to is replaced instead.
+ *
+ * Starts with fastestMethod and falls back to slower methods if it isn't
+ * supported. If usedMethod isn't null, then it's set to the method that
+ * finished the copy.
+ *
  * Returns true on success, false on failure.
  */
-bool copyRegularFile(
-    const std::string& sourcePath, const std::string& destinationPath);
+bool copyRegularFile(const std::string& sourcePath,
+    const std::string& destinationPath,
+    CopyMethod fastestMethod = CLONE_COPY_METHOD,
+    CopyMethod* usedMethod = nullptr);
 /*
  * Copies the contents of the directory at sourcePath and all its children,
  * recursively. Fails if sourcePath couldn't be read as a directory, or if
  * destinationPath couldn't be written to as a directory. Attempts to create
  * parent directories if they don't exist for destinatinPath.
  *
+ * The copy is built in a temporary directory next to destinationPath and then
+ * swapped with it. The temporary directory starts with hard links to what's in
+ * the old directory, so anything in it that isn't in sourcePath is kept.
+ *
+ * The copy methods work the same as in copyRegularFile(), where usedMethod is
+ * set to the slowest method used for any file.
+ *
  * Returns true on success, false on failure.
  */
-bool copyDirectory(
-    const std::string& sourcePath, const std::string& destinationPath);
+bool copyDirectory(const std::string& sourcePath,
+    const std::string& destinationPath,
+    CopyMethod fastestMethod = CLONE_COPY_METHOD,
+    CopyMethod* usedMethod = nullptr);
 /*
  * Copies the given file to the path at destinationPath. Works on regular files
  * and directories, and fails if it is not one of those two.
  *
+ * The copy methods work the same as in copyDirectory().
+ *
  * Returns true on success, false on failure.
  */
-bool copyFile(
-    const std::string& sourcePath, const std::string& destinationPath);
+bool copyFile(const std::string& sourcePath,
+    const std::string& destinationPath,
+    CopyMethod fastestMethod = CLONE_COPY_METHOD,
+    CopyMethod* usedMethod = nullptr);
+/* How a file is put in place when it's installed. */
+enum InstallMode {
+    /* Copies the file with copyFile(). */
+    COPY_INSTALL_MODE,
+    /* Creates a symlink to the file. */
+    SYMLINK_INSTALL_MODE,
+    /*
+     * Creates a hard link to the file, which only works for regular files on
+     * the same filesystem.
+     */
+    HARDLINK_INSTALL_MODE
+};
+/* Returns a short name for mode, like "symlink". */
+const char* getInstallModeName(InstallMode mode);
+/*
+ * Puts a link to sourcePath at destinationPath with the given mode, or copies
+ * it for COPY_INSTALL_MODE. A symlink's target is sourcePath exactly, so it
+ * should be absolute. Attempts to create parent directories if they don't
+ * exist.
+ *
+ * The link is made next to destinationPath and renamed over it, replacing
+ * whatever is there. That includes symlinks, which aren't followed, and
+ * directories, which are removed first.
+ *
+ * Returns true on success, false on failure.
+ */
+bool linkFile(const std::string& sourcePath,
+    const std::string& destinationPath, InstallMode mode);
+/*
+ * Returns whether destinationPath is a symlink whose target is exactly
+ * sourcePath for SYMLINK_INSTALL_MODE, or the same file as sourcePath for
+ * HARDLINK_INSTALL_MODE. Returns false for COPY_INSTALL_MODE.
+ */
+bool isLinkTo(const std::string& sourcePath,
+    const std::string& destinationPath, InstallMode mode);
+/*
+ * Returns path relative to the root directory instead of the current
+ * directory, without any "./" at the start. Doesn't resolve symlinks.
+ */
+std::string getAbsolutePath(const std::string& path);
 /*
  * Function to be used with scandir as a filter that doesn't filter anything.
  *
@@ -191,6 +341,79 @@ int returnOne(const struct dirent* entry);
  * Returns a path pointing to the same file with extra slashes removed, etc.
  */
 std::string getCanonicalPath(const std::string& path);
+/* The starting value for a hash from hashBytes(). */
+const uint64_t HASH_OFFSET_BASIS = 14695981039346656037ULL;
+/*
+ * Hashes size bytes starting at data with 64 bit FNV-1a. A hash of more bytes
+ * can be continued by passing the hash so far as hash. This is meant for
+ * noticing when contents change, not for anything to do with security.
+ *
+ * Returns the hash of the given bytes.
+ */
+uint64_t hashBytes(
+    const char* data, size_t size, uint64_t hash = HASH_OFFSET_BASIS);
+/*
+ * Hashes the contents of the file at path the same way as hashBytes() and
+ * stores it in hash.
+ *
+ * Returns true on success, false if the file couldn't be read.
+ */
+bool hashFile(const std::string& path, uint64_t& hash);
+/*
+ * Reads both open files from their current offsets to the end, comparing them
+ * a chunk at a time.
+ *
+ * Returns true if they have the same contents, false if they don't or if
+ * either couldn't be read.
+ */
+bool haveSameContents(int firstDescriptor, int secondDescriptor);
+/*
+ * Reads from descriptor into buffer until it's full or the end of the file is
+ * reached.
+ *
+ * Returns the number of bytes read, or -1 on failure.
+ */
+ssize_t readFully(int descriptor, char* buffer, size_t size);
+/*
+ * Returns whether or not path is the same as ancestor or inside of it. Both
+ * paths should already be shell expanded.
+ */
+bool pathContains(const std::string& ancestor, const std::string& path);
+/*
+ * Finds every pair of paths where one is the same as or inside of the other.
+ * Each path is given along with the index of whatever it belongs to, and
+ * trailing slashes are ignored.
+ *
+ * Returns the index pairs of the overlapping paths with the smaller index
+ * first. Paths with the same index aren't paired, and a pair may be returned
+ * more than once.
+ */
+std::vector<std::pair<int, int>> findOverlappingPaths(
+    std::vector<std::pair<std::string, int>> paths);
+
+/* A warning that's kept to be given later by giveConfigWarnings(). */
+struct ConfigWarning {
+    std::string text;
+    /* Whether text is written to standard error as is instead of by warnx. */
+    bool isRaw;
+};
+/*
+ * Gives a warning about the config file with warnx, or adds it to the
+ * warnings being collected on the current thread.
+ */
+void configWarning(const char* format, ...);
+void vConfigWarning(const char* format, va_list argumentList);
+/* Like configWarning(), but writes text to standard error as it is. */
+void writeConfigWarning(const std::string& text);
+/*
+ * Makes config warnings on the current thread be added to warnings instead of
+ * given right away, or given right away again if warnings is null. Parts of a
+ * config file that are read at the same time use this to give their warnings
+ * in file order.
+ */
+void collectConfigWarnings(std::vector<ConfigWarning>* warnings);
+/* Gives the collected warnings in order. */
+void giveConfigWarnings(const std::vector<ConfigWarning>& warnings);
 } /* namespace dfm */
 
 #endif /* UTIL_H */
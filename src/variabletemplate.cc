@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "config.h"
+
+#include "variabletemplate.h"
+
+#include "util.h"
+
+namespace dfm {
+
+bool
+VariableTemplate::compile(const std::string& text)
+{
+    segments.clear();
+    literalLength = 0;
+    std::string literal;
+    std::string::size_type position = 0;
+    while (position < text.length()) {
+        std::string::size_type reference = text.find("${", position);
+        if (reference == std::string::npos) {
+            literal.append(text, position, std::string::npos);
+            break;
+        }
+        /* A "$${" is a "${" that doesn't start a reference. */
+        if (reference > position && text[reference - 1] == '$') {
+            literal.append(text, position, reference - position - 1);
+            literal += "${";
+            position = reference + 2;
+            continue;
+        }
+        literal.append(text, position, reference - position);
+        std::string::size_type nameStart = reference + 2;
+        std::string::size_type nameEnd = text.find('}', nameStart);
+        if (nameEnd == std::string::npos) {
+            configWarning(
+                "Unclosed variable reference in \"%s\".", text.c_str());
+            return false;
+        }
+        if (nameEnd == nameStart) {
+            configWarning("Empty variable name in \"%s\".", text.c_str());
+            return false;
+        }
+        addLiteral(literal);
+        literal.clear();
+        segments.push_back(
+            { text.substr(nameStart, nameEnd - nameStart), true });
+        position = nameEnd + 1;
+    }
+    addLiteral(literal);
+    return true;
+}
+
+void
+VariableTemplate::expand(
+    const ReaderEnvironment& environment, std::string& result) const
+{
+    std::vector<const std::string*> values;
+    size_t length = literalLength;
+    for (const auto& segment : segments) {
+        if (!segment.isVariable)
+            continue;
+        const std::string* value = environment.findVariable(segment.text);
+        values.push_back(value);
+        /* Room for the reference itself if it's left alone. */
+        length += (value != nullptr) ? value->length()
+                                     : segment.text.length() + 3;
+    }
+    result.clear();
+    result.reserve(length);
+    auto value = values.begin();
+    for (const auto& segment : segments) {
+        if (!segment.isVariable) {
+            result += segment.text;
+            continue;
+        }
+        /*
+         * Leave references to anything that isn't a config variable for
+         * path expansion, which can find it in the environment.
+         */
+        if (*value != nullptr)
+            result += **value;
+        else
+            result += "${" + segment.text + "}";
+        value++;
+    }
+}
+
+bool
+VariableTemplate::hasReferences(const std::string& text)
+{
+    return text.find("${") != std::string::npos;
+}
+
+void
+VariableTemplate::addLiteral(const std::string& text)
+{
+    if (text.empty())
+        return;
+    segments.push_back({ text, false });
+    literalLength += text.length();
+}
+} /* namespace dfm */
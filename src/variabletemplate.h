@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2016 Jason Waataja
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef VARIABLE_TEMPLATE_H
+#define VARIABLE_TEMPLATE_H
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+#include "readerenvironment.h"
+
+namespace dfm {
+
+/*
+ * Text with references to variables in it like ${name}, split up into
+ * literal text and references ahead of time so that filling in the variables
+ * only has to put the pieces together. A "$${" stands for a literal "${".
+ *
+ * The "${" that's left is only kept from being looked up as a config
+ * variable. A path it ends up in still has environment variables expanded in
+ * it later.
+ */
+class VariableTemplate {
+public:
+    /*
+     * Splits text into literal text and variable references. Gives a warning
+     * if a reference isn't closed or has no name.
+     *
+     * Returns true on success, false on failure.
+     */
+    bool compile(const std::string& text);
+    /*
+     * Sets result to the text with each reference replaced by the value of
+     * the variable in environment. References to variables that aren't set
+     * are left as they are, so that paths can still refer to environment
+     * variables that way.
+     */
+    void expand(
+        const ReaderEnvironment& environment, std::string& result) const;
+
+    /*
+     * Returns whether text has a reference or an escaped "${" in it. Text
+     * without either is the same after being expanded.
+     */
+    static bool hasReferences(const std::string& text);
+
+private:
+    struct Segment {
+        /* The literal text or the name of the variable. */
+        std::string text;
+        bool isVariable;
+    };
+    std::vector<Segment> segments;
+    /* The length of all of the literal text, to size the result up front. */
+    size_t literalLength = 0;
+
+    void addLiteral(const std::string& text);
+};
+} /* namespace dfm */
+
+#endif /* VARIABLE_TEMPLATE_H */